@@ -3,16 +3,20 @@ from esphome import automation
 from esphome import pins
 import esphome.codegen as cg
 import esphome.config_validation as cv
+from esphome.core import CORE
 from esphome.components import uart
 from esphome.components import sensor as esphome_sensor
 from esphome.components import text_sensor as esphome_text_sensor
 from esphome.const import (
        CONF_ID,
+       CONF_OPTIONS,
+       CONF_PLATFORM,
        CONF_TIME_ID,
        CONF_TRIGGER_ID,
        CONF_TYPE,
        CONF_NUMBER,
        CONF_VALUE,
+       CONF_TIMEOUT,
        ENTITY_CATEGORY_DIAGNOSTIC,
        STATE_CLASS_MEASUREMENT,
 )
@@ -20,8 +24,36 @@ from esphome.const import (
 DEPENDENCIES = ["uart"]
 
 CONF_IGNORE_MCU_UPDATE_ON_DATAPOINTS = "ignore_mcu_update_on_datapoints"
+CONF_RETAIN_DATAPOINT_VALUES = "retain_datapoint_values"
+CONF_NOTIFY_ON_CHANGE_ONLY = "notify_on_change_only"
+CONF_NOTIFY_REFRESH_INTERVAL = "notify_refresh_interval"
+CONF_WARM_START = "warm_start"
+CONF_STORAGE = "storage"
+CONF_MIN_SAVE_INTERVAL = "min_save_interval"
+CONF_CACHE_HANDSHAKE = "cache_handshake"
+CONF_INIT_MODE = "init_mode"
+CONF_MAX_WRITES_IN_FLIGHT = "max_writes_in_flight"
+CONF_CONFIRM_WRITE_VALUE = "confirm_write_value"
+CONF_WRITE_CONFIRM_TIMEOUT = "write_confirm_timeout"
 
 CONF_REPORT_AP_NAME = "report_ap_name"
+CONF_MAX_UART_POLL_TIME = "max_uart_poll_time"
+CONF_MAX_UART_POLL_BYTES = "max_uart_poll_bytes"
+CONF_MAX_FRAMES_PER_LOOP = "max_frames_per_loop"
+CONF_MAX_COMMANDS_PER_LOOP = "max_commands_per_loop"
+CONF_COMMAND_QUEUE_SIZE = "command_queue_size"
+CONF_COMMAND_QUEUE_OVERFLOW = "command_queue_overflow"
+CONF_MAX_COMMAND_PAYLOAD_SIZE = "max_command_payload_size"
+CONF_RX_BUFFER_SIZE = "rx_buffer_size"
+CONF_DATAPOINT_INLINE_SIZE = "datapoint_inline_size"
+CONF_COROUTINE_FRAMES = "coroutine_frames"
+CONF_COROUTINE_FRAME_SIZE = "coroutine_frame_size"
+CONF_STRING_POOL_SIZE = "string_pool_size"
+CONF_STRING_POOL_SLOTS = "string_pool_slots"
+CONF_MIN_RESPONSE_TIMEOUT = "min_response_timeout"
+CONF_MAX_RESPONSE_TIMEOUT = "max_response_timeout"
+CONF_MIN_COMMAND_DELAY = "min_command_delay"
+CONF_MAX_COMMAND_DELAY = "max_command_delay"
 CONF_ON_DATAPOINT_UPDATE = "on_datapoint_update"
 CONF_DATAPOINT = "datapoint"
 CONF_DATAPOINT_TYPE = "datapoint_type"
@@ -29,6 +61,12 @@ CONF_STATUS_PIN = "status_pin"
 CONF_DIAGNOSTICS = "diagnostics"
 CONF_SMA_STATS = "sma_stats"
 CONF_NUM_GARBAGE_BYTES = "num_garbage_bytes"
+CONF_NUM_POLL_BUDGET_HITS = "num_poll_budget_hits"
+CONF_NUM_EXPIRED_FRAMES = "num_expired_frames"
+CONF_NUM_UNCONFIRMED_WRITES = "num_unconfirmed_writes"
+CONF_COMMAND_QUEUE = "command_queue"
+CONF_NUM_DROPPED_COMMANDS = "num_dropped_commands"
+CONF_COMMAND_QUEUE_HIGH_WATER = "command_queue_high_water"
 CONF_UNKNOWN_COMMANDS = "unknown_commands"
 CONF_UNKNOWN_EXTENDED_COMMANDS = "unknown_extended_commands"
 CONF_UNHANDLED_DATAPOINTS = "unhandled_datapoints"
@@ -43,9 +81,13 @@ UIntDatapointValue = uyat_ns.class_("UIntDatapointValue")
 EnumDatapointValue = uyat_ns.class_("EnumDatapointValue")
 UyatDatapoint = uyat_ns.class_("UyatDatapoint")
 FactoryResetType = uyat_ns.enum("FactoryResetType")
+UyatQueueOverflowPolicy = uyat_ns.enum("UyatQueueOverflowPolicy", is_class=True)
+WarmStartStorage = uyat_ns.enum("WarmStartStorage", is_class=True)
+UyatInitMode = uyat_ns.enum("UyatInitMode", is_class=True)
 Uyat = uyat_ns.class_("Uyat", cg.Component, uart.UARTDevice)
 MatchingDatapoint = uyat_ns.class_("MatchingDatapoint")
 UyatFactoryResetAction = uyat_ns.class_("FactoryResetAction", automation.Action)
+UyatWriteDatapointAction = uyat_ns.class_("WriteDatapointAction", automation.Action)
 
 FACTORY_RESET_TYPES = {
     "HW": FactoryResetType.BY_HW,
@@ -53,6 +95,36 @@ FACTORY_RESET_TYPES = {
     "APP_WIPE": FactoryResetType.BY_APP_WIPE,
 }
 
+QUEUE_OVERFLOW_POLICIES = {
+    "drop_oldest": UyatQueueOverflowPolicy.DROP_OLDEST,
+    "drop_newest": UyatQueueOverflowPolicy.DROP_NEWEST,
+    "coalesce": UyatQueueOverflowPolicy.COALESCE,
+}
+
+WARM_START_STORAGES = {
+    "flash": WarmStartStorage.FLASH,
+    "rtc": WarmStartStorage.RTC,
+}
+
+INIT_MODES = {
+    "serial": UyatInitMode.SERIAL,
+    "pipelined": UyatInitMode.PIPELINED,
+}
+
+# HEARTBEAT, PRODUCT_QUERY and CONF_QUERY can be waiting for their answers at once
+PIPELINED_COMMANDS_IN_FLIGHT = 3
+
+# The string pool holds the log lines and hex dumps of frames, and the strings kept by entities.
+STRING_POOL_BASE_SIZE = 768
+# a text sensor keeps its last received and last set value
+STRING_POOL_TEXT_SENSOR_SIZE = 2 * 64
+# shorter strings are stored in the string object itself
+STRING_POOL_SSO_LENGTH = 15
+# each allocation has a 4 byte header and takes a multiple of 4 bytes
+STRING_POOL_BLOCK_OVERHEAD = 4 + 3
+STRING_POOL_MAX_SIZE = 0xFFFC
+STRING_POOL_AVERAGE_ALLOCATION = 16
+
 DPTYPE_ANY = "any"
 DPTYPE_DETECT = "detect"
 DPTYPE_RAW = "raw"
@@ -154,6 +226,30 @@ def assign_declare_id(value):
     return value
 
 
+def estimate_string_pool_size(uyat_id):
+    size = STRING_POOL_BASE_SIZE
+    for entity in CORE.config.get("text_sensor", []):
+        if entity.get(CONF_PLATFORM) != "uyat" or entity[CONF_UYAT_ID].id != uyat_id.id:
+            continue
+        if CONF_OPTIONS in entity:
+            for option in entity[CONF_OPTIONS].values():
+                if len(option) > STRING_POOL_SSO_LENGTH:
+                    size += len(option) + 1 + STRING_POOL_BLOCK_OVERHEAD
+        else:
+            size += STRING_POOL_TEXT_SENSOR_SIZE
+    return min((size + 63) // 64 * 64, STRING_POOL_MAX_SIZE)
+
+
+def validate_timing_limits(config):
+    for min_key, max_key in (
+        (CONF_MIN_RESPONSE_TIMEOUT, CONF_MAX_RESPONSE_TIMEOUT),
+        (CONF_MIN_COMMAND_DELAY, CONF_MAX_COMMAND_DELAY),
+    ):
+        if config[min_key] > config[max_key]:
+            raise cv.Invalid(f"{min_key} must not be greater than {max_key}")
+    return config
+
+
 UYAT_DIAGNOSTIC_SENSORS_SCHEMA = cv.Schema(
     {
         cv.Optional(CONF_SMA_STATS, default=False): cv.boolean,
@@ -165,6 +261,34 @@ UYAT_DIAGNOSTIC_SENSORS_SCHEMA = cv.Schema(
             state_class=STATE_CLASS_MEASUREMENT,
             entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
         ),
+        cv.Optional(CONF_NUM_POLL_BUDGET_HITS): esphome_sensor.sensor_schema(
+            accuracy_decimals=0,
+            state_class=STATE_CLASS_MEASUREMENT,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        cv.Optional(CONF_NUM_EXPIRED_FRAMES): esphome_sensor.sensor_schema(
+            accuracy_decimals=0,
+            state_class=STATE_CLASS_MEASUREMENT,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        cv.Optional(CONF_NUM_UNCONFIRMED_WRITES): esphome_sensor.sensor_schema(
+            accuracy_decimals=0,
+            state_class=STATE_CLASS_MEASUREMENT,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        cv.Optional(CONF_COMMAND_QUEUE): esphome_text_sensor.text_sensor_schema(
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        cv.Optional(CONF_NUM_DROPPED_COMMANDS): esphome_sensor.sensor_schema(
+            accuracy_decimals=0,
+            state_class=STATE_CLASS_MEASUREMENT,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        cv.Optional(CONF_COMMAND_QUEUE_HIGH_WATER): esphome_sensor.sensor_schema(
+            accuracy_decimals=0,
+            state_class=STATE_CLASS_MEASUREMENT,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
         cv.Optional(CONF_UNKNOWN_COMMANDS): esphome_text_sensor.text_sensor_schema(
             entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
         ),
@@ -188,9 +312,87 @@ CONFIG_SCHEMA = (
             cv.Optional(CONF_DIAGNOSTICS): UYAT_DIAGNOSTIC_SENSORS_SCHEMA,
             cv.Optional(CONF_TIME_ID): cv.use_id(time.RealTimeClock),
             cv.Optional(CONF_REPORT_AP_NAME, default="smartlife"): cv.string,
+            cv.Optional(CONF_MAX_UART_POLL_TIME, default="10ms"): cv.All(
+                cv.positive_time_period_milliseconds,
+                cv.Range(min=cv.TimePeriod(milliseconds=1)),
+            ),
+            cv.Optional(CONF_MAX_UART_POLL_BYTES, default=256): cv.int_range(
+                min=1, max=4096
+            ),
+            cv.Optional(CONF_MAX_FRAMES_PER_LOOP, default=8): cv.int_range(
+                min=1, max=255
+            ),
+            cv.Optional(CONF_MAX_COMMANDS_PER_LOOP, default=2): cv.int_range(
+                min=1, max=255
+            ),
+            cv.Optional(CONF_COMMAND_QUEUE_SIZE, default=16): cv.int_range(
+                min=4, max=255
+            ),
+            cv.Optional(CONF_COMMAND_QUEUE_OVERFLOW, default="drop_oldest"): cv.enum(
+                QUEUE_OVERFLOW_POLICIES, lower=True
+            ),
+            cv.Optional(CONF_MAX_COMMAND_PAYLOAD_SIZE, default=256): cv.int_range(
+                min=32, max=4096
+            ),
+            cv.Optional(CONF_RX_BUFFER_SIZE, default=2048): cv.int_range(
+                min=256, max=16384
+            ),
+            cv.Optional(CONF_DATAPOINT_INLINE_SIZE, default=16): cv.int_range(
+                min=8, max=255
+            ),
+            cv.Optional(CONF_STRING_POOL_SIZE): cv.int_range(
+                min=256, max=STRING_POOL_MAX_SIZE
+            ),
+            cv.Optional(CONF_STRING_POOL_SLOTS): cv.int_range(min=4, max=4096),
+            cv.Optional(CONF_COROUTINE_FRAMES, default=4): cv.int_range(
+                min=1, max=32
+            ),
+            cv.Optional(CONF_COROUTINE_FRAME_SIZE, default=512): cv.int_range(
+                min=64, max=4096
+            ),
+            cv.Optional(
+                CONF_MIN_RESPONSE_TIMEOUT, default="50ms"
+            ): cv.positive_time_period_milliseconds,
+            cv.Optional(
+                CONF_MAX_RESPONSE_TIMEOUT, default="300ms"
+            ): cv.positive_time_period_milliseconds,
+            cv.Optional(
+                CONF_MIN_COMMAND_DELAY, default="2ms"
+            ): cv.positive_time_period_milliseconds,
+            cv.Optional(
+                CONF_MAX_COMMAND_DELAY, default="10ms"
+            ): cv.positive_time_period_milliseconds,
             cv.Optional(CONF_IGNORE_MCU_UPDATE_ON_DATAPOINTS): cv.ensure_list(
                 cv.uint8_t
             ),
+            cv.Optional(CONF_RETAIN_DATAPOINT_VALUES): cv.ensure_list(cv.uint8_t),
+            cv.Optional(CONF_NOTIFY_ON_CHANGE_ONLY): cv.Any(
+                cv.one_of("all", lower=True), cv.ensure_list(cv.uint8_t)
+            ),
+            cv.Optional(
+                CONF_NOTIFY_REFRESH_INTERVAL
+            ): cv.positive_time_period_milliseconds,
+            cv.Optional(CONF_WARM_START): cv.Schema(
+                {
+                    cv.Optional(CONF_STORAGE, default="flash"): cv.enum(
+                        WARM_START_STORAGES, lower=True
+                    ),
+                    cv.Optional(
+                        CONF_MIN_SAVE_INTERVAL, default="5min"
+                    ): cv.positive_time_period_milliseconds,
+                }
+            ),
+            cv.Optional(CONF_CACHE_HANDSHAKE, default=False): cv.boolean,
+            cv.Optional(CONF_INIT_MODE, default="serial"): cv.enum(
+                INIT_MODES, lower=True
+            ),
+            cv.Optional(CONF_MAX_WRITES_IN_FLIGHT, default=1): cv.int_range(
+                min=1, max=16
+            ),
+            cv.Optional(CONF_CONFIRM_WRITE_VALUE, default=False): cv.boolean,
+            cv.Optional(
+                CONF_WRITE_CONFIRM_TIMEOUT, default="5s"
+            ): cv.positive_time_period_milliseconds,
             cv.Optional(CONF_STATUS_PIN): pins.gpio_output_pin_schema,
             cv.Optional(CONF_ON_DATAPOINT_UPDATE): automation.validate_automation(
                 {
@@ -208,6 +410,7 @@ CONFIG_SCHEMA = (
     )
     .extend(cv.COMPONENT_SCHEMA)
     .extend(uart.UART_DEVICE_SCHEMA)
+    .add_extra(validate_timing_limits)
 )
 
 
@@ -216,6 +419,39 @@ async def to_code(config):
     await cg.register_component(var, config)
     await uart.register_uart_device(var, config)
     cg.add(var.set_report_ap_name(config[CONF_REPORT_AP_NAME]))
+    cg.add(var.set_max_uart_poll_time(config[CONF_MAX_UART_POLL_TIME]))
+    cg.add(var.set_max_uart_poll_bytes(config[CONF_MAX_UART_POLL_BYTES]))
+    cg.add(var.set_max_frames_per_loop(config[CONF_MAX_FRAMES_PER_LOOP]))
+    cg.add(var.set_max_commands_per_loop(config[CONF_MAX_COMMANDS_PER_LOOP]))
+    cg.add_define("UYAT_COMMAND_QUEUE_SIZE", config[CONF_COMMAND_QUEUE_SIZE])
+    cg.add_define(
+        "UYAT_MAX_COMMAND_PAYLOAD_SIZE", config[CONF_MAX_COMMAND_PAYLOAD_SIZE]
+    )
+    cg.add_define("UYAT_RX_BUFFER_SIZE", config[CONF_RX_BUFFER_SIZE])
+    cg.add_define("UYAT_DATAPOINT_INLINE_SIZE", config[CONF_DATAPOINT_INLINE_SIZE])
+    string_pool_size = config.get(CONF_STRING_POOL_SIZE)
+    if string_pool_size is None:
+        string_pool_size = estimate_string_pool_size(config[CONF_ID])
+    cg.add_define("UYAT_STRING_POOL_SIZE", string_pool_size)
+    cg.add_define(
+        "UYAT_STRING_POOL_SLOTS",
+        config.get(CONF_STRING_POOL_SLOTS, string_pool_size // STRING_POOL_AVERAGE_ALLOCATION),
+    )
+    cg.add_define("UYAT_COROUTINE_FRAMES", config[CONF_COROUTINE_FRAMES])
+    cg.add_define("UYAT_COROUTINE_FRAME_SIZE", config[CONF_COROUTINE_FRAME_SIZE])
+    cg.add(
+        var.set_command_queue_overflow_policy(config[CONF_COMMAND_QUEUE_OVERFLOW])
+    )
+    cg.add(
+        var.set_response_timeout_limits(
+            config[CONF_MIN_RESPONSE_TIMEOUT], config[CONF_MAX_RESPONSE_TIMEOUT]
+        )
+    )
+    cg.add(
+        var.set_command_delay_limits(
+            config[CONF_MIN_COMMAND_DELAY], config[CONF_MAX_COMMAND_DELAY]
+        )
+    )
     if CONF_TIME_ID in config:
         time_ = await cg.get_variable(config[CONF_TIME_ID])
         cg.add(var.set_time_id(time_))
@@ -225,6 +461,31 @@ async def to_code(config):
     if CONF_IGNORE_MCU_UPDATE_ON_DATAPOINTS in config:
         for dp in config[CONF_IGNORE_MCU_UPDATE_ON_DATAPOINTS]:
             cg.add(var.add_ignore_mcu_update_on_datapoints(dp))
+    for dp in config.get(CONF_RETAIN_DATAPOINT_VALUES, []):
+        cg.add(var.add_retained_datapoint(dp))
+    if config.get(CONF_NOTIFY_ON_CHANGE_ONLY) == "all":
+        cg.add(var.set_notify_on_change_only_all())
+    else:
+        for dp in config.get(CONF_NOTIFY_ON_CHANGE_ONLY, []):
+            cg.add(var.add_notify_on_change_only(dp))
+    if CONF_NOTIFY_REFRESH_INTERVAL in config:
+        cg.add(var.set_notify_refresh_interval(config[CONF_NOTIFY_REFRESH_INTERVAL]))
+    if CONF_WARM_START in config:
+        warm_start = config[CONF_WARM_START]
+        cg.add(
+            var.set_warm_start(
+                warm_start[CONF_STORAGE], warm_start[CONF_MIN_SAVE_INTERVAL]
+            )
+        )
+    cg.add(var.set_cache_handshake(config[CONF_CACHE_HANDSHAKE]))
+    cg.add(var.set_init_mode(config[CONF_INIT_MODE]))
+    cg.add(var.set_max_writes_in_flight(config[CONF_MAX_WRITES_IN_FLIGHT]))
+    cg.add(var.set_confirm_write_value(config[CONF_CONFIRM_WRITE_VALUE]))
+    cg.add(var.set_write_confirm_timeout(config[CONF_WRITE_CONFIRM_TIMEOUT]))
+    commands_in_flight = config[CONF_MAX_WRITES_IN_FLIGHT]
+    if config[CONF_INIT_MODE] == "pipelined":
+        commands_in_flight = max(commands_in_flight, PIPELINED_COMMANDS_IN_FLIGHT)
+    cg.add_define("UYAT_MAX_COMMANDS_IN_FLIGHT", commands_in_flight)
     for conf in config.get(CONF_ON_DATAPOINT_UPDATE, []):
         trigger = cg.new_Pvariable(
             conf[CONF_TRIGGER_ID], var, conf[CONF_DATAPOINT]
@@ -246,6 +507,36 @@ async def to_code(config):
                 diagnostics_config[CONF_NUM_GARBAGE_BYTES]
             )
             cg.add(var.set_num_garbage_bytes_sensor(sens))
+        if CONF_NUM_POLL_BUDGET_HITS in diagnostics_config:
+            sens = await esphome_sensor.new_sensor(
+                diagnostics_config[CONF_NUM_POLL_BUDGET_HITS]
+            )
+            cg.add(var.set_num_poll_budget_hits_sensor(sens))
+        if CONF_NUM_EXPIRED_FRAMES in diagnostics_config:
+            sens = await esphome_sensor.new_sensor(
+                diagnostics_config[CONF_NUM_EXPIRED_FRAMES]
+            )
+            cg.add(var.set_num_expired_frames_sensor(sens))
+        if CONF_NUM_UNCONFIRMED_WRITES in diagnostics_config:
+            sens = await esphome_sensor.new_sensor(
+                diagnostics_config[CONF_NUM_UNCONFIRMED_WRITES]
+            )
+            cg.add(var.set_num_unconfirmed_writes_sensor(sens))
+        if CONF_COMMAND_QUEUE in diagnostics_config:
+            tsens = await esphome_text_sensor.new_text_sensor(
+                diagnostics_config[CONF_COMMAND_QUEUE]
+            )
+            cg.add(var.set_command_queue_text_sensor(tsens))
+        if CONF_NUM_DROPPED_COMMANDS in diagnostics_config:
+            sens = await esphome_sensor.new_sensor(
+                diagnostics_config[CONF_NUM_DROPPED_COMMANDS]
+            )
+            cg.add(var.set_num_dropped_commands_sensor(sens))
+        if CONF_COMMAND_QUEUE_HIGH_WATER in diagnostics_config:
+            sens = await esphome_sensor.new_sensor(
+                diagnostics_config[CONF_COMMAND_QUEUE_HIGH_WATER]
+            )
+            cg.add(var.set_command_queue_high_water_sensor(sens))
         if CONF_UNKNOWN_COMMANDS in diagnostics_config:
             tsens = await esphome_text_sensor.new_text_sensor(
                 diagnostics_config[CONF_UNKNOWN_COMMANDS]
@@ -294,3 +585,39 @@ async def uyat_factory_reset_to_code(config, action_id, template_arg, args):
     var = cg.new_Pvariable(action_id, template_arg, paren)
     cg.add(var.set_reset_type(config[CONF_TYPE]))
     return var
+
+
+UYAT_WRITE_DATAPOINT_TYPES = {
+    DPTYPE_BOOL: UyatDatapointType.BOOLEAN,
+    DPTYPE_UINT: UyatDatapointType.INTEGER,
+    DPTYPE_ENUM: UyatDatapointType.ENUM,
+    DPTYPE_BITMAP: UyatDatapointType.BITMAP,
+}
+
+UYAT_WRITE_DATAPOINT_SCHEMA = UYAT_ACTION_SCHEMA.extend(
+    cv.Schema(
+        {
+            cv.Required(CONF_DATAPOINT): cv.uint8_t,
+            cv.Optional(CONF_DATAPOINT_TYPE, default=DPTYPE_UINT): cv.enum(
+                UYAT_WRITE_DATAPOINT_TYPES, lower=True
+            ),
+            cv.Required(CONF_VALUE): cv.templatable(cv.uint32_t),
+            cv.Optional(CONF_TIMEOUT): cv.positive_time_period_milliseconds,
+        }
+    )
+)
+
+
+@automation.register_action(
+    "uyat.write_datapoint", UyatWriteDatapointAction, UYAT_WRITE_DATAPOINT_SCHEMA
+)
+async def uyat_write_datapoint_to_code(config, action_id, template_arg, args):
+    paren = await cg.get_variable(config[CONF_ID])
+    var = cg.new_Pvariable(action_id, template_arg, paren)
+    cg.add(var.set_datapoint_id(config[CONF_DATAPOINT]))
+    cg.add(var.set_datapoint_type(config[CONF_DATAPOINT_TYPE]))
+    template_ = await cg.templatable(config[CONF_VALUE], args, cg.uint32)
+    cg.add(var.set_value(template_))
+    if CONF_TIMEOUT in config:
+        cg.add(var.set_timeout(config[CONF_TIMEOUT]))
+    return var
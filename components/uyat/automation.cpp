@@ -8,20 +8,20 @@ namespace esphome {
 namespace uyat {
 
 UyatRawDatapointUpdateTrigger::UyatRawDatapointUpdateTrigger(Uyat *parent, uint8_t sensor_id) {
-  parent->register_datapoint_listener(MatchingDatapoint{.number = sensor_id, .types = {UyatDatapointType::RAW}}, [this](const UyatDatapoint &dp) {
-    auto * dp_value = std::get_if<RawDatapointValue>(&dp.value);
+  parent->register_datapoint_listener(MatchingDatapoint{.number = sensor_id, .types = {UyatDatapointType::RAW}}, [this](const DatapointView &dp) {
+    const auto dp_value = dp.get_raw();
     if (!dp_value)
     {
       ESP_LOGW(TAG, "Unexpected datapoint %d type (expected RAW, got %s)!", dp.number, dp.get_type_name());
       return;
     }
-    this->trigger(dp_value->value);
+    this->trigger(std::vector<uint8_t>(dp_value->begin(), dp_value->end()));
   });
 }
 
 UyatBoolDatapointUpdateTrigger::UyatBoolDatapointUpdateTrigger(Uyat *parent, uint8_t sensor_id) {
-  parent->register_datapoint_listener(MatchingDatapoint{.number = sensor_id, .types = {UyatDatapointType::BOOLEAN}}, [this](const UyatDatapoint &dp) {
-    auto * dp_value = std::get_if<BoolDatapointValue>(&dp.value);
+  parent->register_datapoint_listener(MatchingDatapoint{.number = sensor_id, .types = {UyatDatapointType::BOOLEAN}}, [this](const DatapointView &dp) {
+    const auto dp_value = dp.get<BoolDatapointValue>();
     if (!dp_value)
     {
       ESP_LOGW(TAG, "Unexpected datapoint %d type (expected BOOL, got %s)!", dp.number, dp.get_type_name());
@@ -32,8 +32,8 @@ UyatBoolDatapointUpdateTrigger::UyatBoolDatapointUpdateTrigger(Uyat *parent, uin
 }
 
 UyatUIntDatapointUpdateTrigger::UyatUIntDatapointUpdateTrigger(Uyat *parent, uint8_t sensor_id) {
-  parent->register_datapoint_listener(MatchingDatapoint{.number = sensor_id, .types = {UyatDatapointType::INTEGER}}, [this](const UyatDatapoint &dp) {
-    auto * dp_value = std::get_if<UIntDatapointValue>(&dp.value);
+  parent->register_datapoint_listener(MatchingDatapoint{.number = sensor_id, .types = {UyatDatapointType::INTEGER}}, [this](const DatapointView &dp) {
+    const auto dp_value = dp.get<UIntDatapointValue>();
     if (!dp_value)
     {
       ESP_LOGW(TAG, "Unexpected datapoint %d type (expected INTEGER, got %s)!", dp.number, dp.get_type_name());
@@ -44,20 +44,20 @@ UyatUIntDatapointUpdateTrigger::UyatUIntDatapointUpdateTrigger(Uyat *parent, uin
 }
 
 UyatStringDatapointUpdateTrigger::UyatStringDatapointUpdateTrigger(Uyat *parent, uint8_t sensor_id) {
-  parent->register_datapoint_listener(MatchingDatapoint{.number = sensor_id, .types = {UyatDatapointType::STRING}}, [this](const UyatDatapoint &dp) {
-    auto * dp_value = std::get_if<StringDatapointValue>(&dp.value);
+  parent->register_datapoint_listener(MatchingDatapoint{.number = sensor_id, .types = {UyatDatapointType::STRING}}, [this](const DatapointView &dp) {
+    const auto dp_value = dp.get_string();
     if (!dp_value)
     {
       ESP_LOGW(TAG, "Unexpected datapoint %d type (expected STRING, got %s)!", dp.number, dp.get_type_name());
       return;
     }
-    this->trigger(dp_value->value);
+    this->trigger(StaticString(dp_value->begin(), dp_value->end()));
   });
 }
 
 UyatEnumDatapointUpdateTrigger::UyatEnumDatapointUpdateTrigger(Uyat *parent, uint8_t sensor_id) {
-  parent->register_datapoint_listener(MatchingDatapoint{.number = sensor_id, .types = {UyatDatapointType::ENUM}}, [this](const UyatDatapoint &dp) {
-    auto * dp_value = std::get_if<EnumDatapointValue>(&dp.value);
+  parent->register_datapoint_listener(MatchingDatapoint{.number = sensor_id, .types = {UyatDatapointType::ENUM}}, [this](const DatapointView &dp) {
+    const auto dp_value = dp.get<EnumDatapointValue>();
     if (!dp_value)
     {
       ESP_LOGW(TAG, "Unexpected datapoint %d type (expected ENUM, got %s)!", dp.number, dp.get_type_name());
@@ -68,8 +68,8 @@ UyatEnumDatapointUpdateTrigger::UyatEnumDatapointUpdateTrigger(Uyat *parent, uin
 }
 
 UyatBitmapDatapointUpdateTrigger::UyatBitmapDatapointUpdateTrigger(Uyat *parent, uint8_t sensor_id) {
-  parent->register_datapoint_listener(MatchingDatapoint{.number = sensor_id, .types = {UyatDatapointType::BITMAP}}, [this](const UyatDatapoint &dp) {
-    auto * dp_value = std::get_if<BitmapDatapointValue>(&dp.value);
+  parent->register_datapoint_listener(MatchingDatapoint{.number = sensor_id, .types = {UyatDatapointType::BITMAP}}, [this](const DatapointView &dp) {
+    const auto dp_value = dp.get<BitmapDatapointValue>();
     if (!dp_value)
     {
       ESP_LOGW(TAG, "Unexpected datapoint %d type (expected BITMAP, got %s)!", dp.number, dp.get_type_name());
@@ -165,6 +165,8 @@ void UyatClimate::loop() {
 }
 
 void UyatClimate::control(const climate::ClimateCall &call) {
+  DatapointBatch batch(this->parent_);
+
   if (call.get_mode().has_value()) {
     const bool switch_state = *call.get_mode() != climate::CLIMATE_MODE_OFF;
     ESP_LOGV(UyatClimate::TAG, "Setting switch: %s", ONOFF(switch_state));
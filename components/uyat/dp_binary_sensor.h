@@ -1,9 +1,8 @@
 #pragma once
 
-#include <functional>
-
 #include "uyat_datapoint_types.h"
 #include "uyat_string.hpp"
+#include "uyat_delegate.hpp"
 
 namespace esphome::uyat
 {
@@ -12,7 +11,7 @@ struct DpBinarySensor
 {
    static constexpr const char * TAG = "uyat.DpBinarySensor";
 
-   using OnValueCallback = std::function<void(const bool)>;
+   using OnValueCallback = Delegate<void(const bool)>;
 
    struct Config
    {
@@ -31,7 +30,7 @@ struct DpBinarySensor
 
    void init(DatapointHandler& handler)
    {
-      handler.register_datapoint_listener(this->config_.matching_dp, [this](const UyatDatapoint &datapoint) {
+      handler.register_datapoint_listener(this->config_.matching_dp, [this](const DatapointView &datapoint) {
          ESP_LOGV(DpBinarySensor::TAG, "%s processing as binary sensor", datapoint.to_string().c_str());
 
          if (!this->config_.matching_dp.matches(datapoint.get_type()))
@@ -40,7 +39,7 @@ struct DpBinarySensor
             return;
          }
 
-         if (auto * dp_value = std::get_if<BoolDatapointValue>(&datapoint.value))
+         if (const auto dp_value = datapoint.get<BoolDatapointValue>())
          {
             if (!this->config_.matching_dp.allows_single_type())
             {
@@ -51,7 +50,7 @@ struct DpBinarySensor
             callback_(value_.value());
          }
          else
-         if (auto * dp_value = std::get_if<UIntDatapointValue>(&datapoint.value))
+         if (const auto dp_value = datapoint.get<UIntDatapointValue>())
          {
             if (!this->config_.matching_dp.allows_single_type())
             {
@@ -62,7 +61,7 @@ struct DpBinarySensor
             callback_(value_.value());
          }
          else
-         if (auto * dp_value = std::get_if<EnumDatapointValue>(&datapoint.value))
+         if (const auto dp_value = datapoint.get<EnumDatapointValue>())
          {
             if (!this->config_.matching_dp.allows_single_type())
             {
@@ -73,7 +72,7 @@ struct DpBinarySensor
             callback_(value_.value());
          }
          else
-         if (auto * dp_value = std::get_if<BitmapDatapointValue>(&datapoint.value))
+         if (const auto dp_value = datapoint.get<BitmapDatapointValue>())
          {
             if (!this->config_.matching_dp.allows_single_type())
             {
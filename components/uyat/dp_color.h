@@ -3,8 +3,9 @@
 #include "esphome/core/helpers.h"
 #include "uyat_datapoint_types.h"
 #include "uyat_string.hpp"
+#include "uyat_delegate.hpp"
 
-#include <functional>
+#include <string_view>
 
 namespace esphome::uyat
 {
@@ -57,7 +58,7 @@ struct DpColor
       }
    };
 
-   using Callback = std::function<void(const Value&)>;
+   using Callback = Delegate<void(const Value&)>;
 
    DpColor(Callback callback, MatchingDatapoint color_dp, const UyatColorType color_type):
    config_{std::move(color_dp), color_type},
@@ -67,7 +68,7 @@ struct DpColor
    void init(DatapointHandler& handler)
    {
       handler_ = &handler;
-      handler.register_datapoint_listener(this->config_.matching_dp, [this](const UyatDatapoint &datapoint) {
+      handler.register_datapoint_listener(this->config_.matching_dp, [this](const DatapointView &datapoint) {
          ESP_LOGV(DpColor::TAG, "%s processing as color", datapoint.to_string().c_str());
 
          if (!this->config_.matching_dp.matches(datapoint.get_type()))
@@ -76,14 +77,14 @@ struct DpColor
             return;
          }
 
-         if (auto * dp_value = std::get_if<StringDatapointValue>(&datapoint.value))
+         if (const auto dp_value = datapoint.get_string())
          {
             if (!this->config_.matching_dp.allows_single_type())
             {
                this->config_.matching_dp.types = {UyatDatapointType::STRING};
                ESP_LOGI(DpColor::TAG, "Resolved %s", this->config_.matching_dp.to_string().c_str());
             }
-            auto new_value = this->decode_(dp_value->value);
+            auto new_value = this->decode_(*dp_value);
             if (new_value)
             {
                this->last_received_value_ = new_value;
@@ -175,7 +176,7 @@ private:
                int(saturation * 255), int(value * 255));
    }
 
-   std::optional<Value> decode_(const StaticString& raw_value) const
+   std::optional<Value> decode_(const std::string_view raw_value) const
    {
       if (this->config_.color_type == UyatColorType::RGB)
       {
@@ -195,10 +196,10 @@ private:
       return std::nullopt;
    }
 
-   std::optional<Value> decode_as_rgb_(const StaticString& raw_value) const
+   std::optional<Value> decode_as_rgb_(const std::string_view raw_value) const
    {
       const auto rgb_string = raw_value.substr(0, 6);
-      const auto rgb = parse_hex<uint32_t>(rgb_string.c_str(), rgb_string.length());
+      const auto rgb = parse_hex<uint32_t>(rgb_string.data(), rgb_string.length());
       if (!rgb.has_value())
       {
          return std::nullopt;
@@ -209,14 +210,14 @@ private:
                    (*rgb & 0xff) / 255.0f};
    }
 
-   std::optional<Value> decode_as_hsv_(const StaticString& raw_value) const
+   std::optional<Value> decode_as_hsv_(const std::string_view raw_value) const
    {
       const auto hue_string = raw_value.substr(0, 4);
-      const auto hue = parse_hex<uint16_t>(hue_string.c_str(), hue_string.length());
+      const auto hue = parse_hex<uint16_t>(hue_string.data(), hue_string.length());
       const auto sat_string = raw_value.substr(4, 4);
-      const auto saturation = parse_hex<uint16_t>(sat_string.c_str(), sat_string.length());
+      const auto saturation = parse_hex<uint16_t>(sat_string.data(), sat_string.length());
       const auto val_string = raw_value.substr(8, 4);
-      const auto value = parse_hex<uint16_t>(val_string.c_str(), val_string.length());
+      const auto value = parse_hex<uint16_t>(val_string.data(), val_string.length());
       if (!hue.has_value() || !saturation.has_value() || !value.has_value())
       {
          return std::nullopt;
@@ -227,7 +228,7 @@ private:
       return result;
    }
 
-   std::optional<Value> decode_as_rgbhsv_(const StaticString& raw_value) const
+   std::optional<Value> decode_as_rgbhsv_(const std::string_view raw_value) const
    {
       return decode_as_rgb_(raw_value);
    }
@@ -3,17 +3,17 @@
 #include "uyat_datapoint_types.h"
 #include "dp_number.h"
 #include "uyat_string.hpp"
+#include "uyat_delegate.hpp"
 
 #include <optional>
 #include <cstdint>
-#include <functional>
 
 namespace esphome::uyat
 {
 
 struct DpDimmer
 {
-   using BrightnessChangedCallback = std::function<void(const float)>;
+   using BrightnessChangedCallback = Delegate<void(const float)>;
    static constexpr const char* TAG = "uyat.DpDimmer";
 
    struct Config
@@ -44,7 +44,7 @@ struct DpDimmer
    void init(DatapointHandler& handler)
    {
       handler_ = &handler;
-      handler.register_datapoint_listener(this->config_.matching_dp, [this](const UyatDatapoint &datapoint) {
+      handler.register_datapoint_listener(this->config_.matching_dp, [this](const DatapointView &datapoint) {
          ESP_LOGV(DpNumber::TAG, "%s processing as dimmer", datapoint.to_string().c_str());
          if (!this->config_.matching_dp.matches(datapoint.get_type()))
          {
@@ -52,7 +52,7 @@ struct DpDimmer
             return;
          }
 
-         if (auto * dp_value = std::get_if<UIntDatapointValue>(&datapoint.value))
+         if (const auto dp_value = datapoint.get<UIntDatapointValue>())
          {
             if (!this->config_.matching_dp.allows_single_type())
             {
@@ -67,7 +67,7 @@ struct DpDimmer
             callback_(*last_received_value_);
          }
          else
-         if (auto * dp_value = std::get_if<EnumDatapointValue>(&datapoint.value))
+         if (const auto dp_value = datapoint.get<EnumDatapointValue>())
          {
             if (!this->config_.matching_dp.allows_single_type())
             {
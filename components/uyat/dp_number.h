@@ -1,9 +1,8 @@
 #pragma once
 
-#include <functional>
-
 #include "uyat_datapoint_types.h"
 #include "uyat_string.hpp"
+#include "uyat_delegate.hpp"
 
 namespace esphome::uyat
 {
@@ -12,7 +11,7 @@ struct DpNumber
 {
    static constexpr const char * TAG = "uyat.DpNumber";
 
-   using OnValueCallback = std::function<void(const float)>;
+   using OnValueCallback = Delegate<void(const float)>;
 
    struct Config
    {
@@ -29,7 +28,7 @@ struct DpNumber
    void init(DatapointHandler& handler)
    {
       handler_ = &handler;
-      handler.register_datapoint_listener(this->config_.matching_dp, [this](const UyatDatapoint &datapoint) {
+      handler.register_datapoint_listener(this->config_.matching_dp, [this](const DatapointView &datapoint) {
          ESP_LOGV(DpNumber::TAG, "%s processing as number", datapoint.to_string().c_str());
 
          if (!this->config_.matching_dp.matches(datapoint.get_type()))
@@ -38,7 +37,7 @@ struct DpNumber
             return;
          }
 
-         if (auto * dp_value = std::get_if<BoolDatapointValue>(&datapoint.value))
+         if (const auto dp_value = datapoint.get<BoolDatapointValue>())
          {
             if (!this->config_.matching_dp.allows_single_type())
             {
@@ -49,7 +48,7 @@ struct DpNumber
             callback_(last_received_value_.value());
          }
          else
-         if (auto * dp_value = std::get_if<UIntDatapointValue>(&datapoint.value))
+         if (const auto dp_value = datapoint.get<UIntDatapointValue>())
          {
             if (!this->config_.matching_dp.allows_single_type())
             {
@@ -60,7 +59,7 @@ struct DpNumber
             callback_(last_received_value_.value());
          }
          else
-         if (auto * dp_value = std::get_if<EnumDatapointValue>(&datapoint.value))
+         if (const auto dp_value = datapoint.get<EnumDatapointValue>())
          {
             if (!this->config_.matching_dp.allows_single_type())
             {
@@ -71,7 +70,7 @@ struct DpNumber
             callback_(last_received_value_.value());
          }
          else
-         if (auto * dp_value = std::get_if<BitmapDatapointValue>(&datapoint.value))
+         if (const auto dp_value = datapoint.get<BitmapDatapointValue>())
          {
             if (!this->config_.matching_dp.allows_single_type())
             {
@@ -1,9 +1,8 @@
 #pragma once
 
-#include <functional>
-
 #include "uyat_datapoint_types.h"
 #include "uyat_string.hpp"
+#include "uyat_delegate.hpp"
 
 namespace esphome::uyat
 {
@@ -12,7 +11,7 @@ struct DpSwitch
 {
    static constexpr const char * TAG = "uyat.DpSwitch";
 
-   using OnValueCallback = std::function<void(const bool)>;
+   using OnValueCallback = Delegate<void(const bool)>;
 
    struct Config
    {
@@ -28,7 +27,7 @@ struct DpSwitch
    void init(DatapointHandler& handler)
    {
       this->handler_ = &handler;
-      this->handler_->register_datapoint_listener(this->config_.matching_dp, [this](const UyatDatapoint &datapoint) {
+      this->handler_->register_datapoint_listener(this->config_.matching_dp, [this](const DatapointView &datapoint) {
          ESP_LOGV(DpSwitch::TAG, "%s processing as switch", datapoint.to_string().c_str());
 
          if (!this->config_.matching_dp.matches(datapoint.get_type()))
@@ -37,7 +36,7 @@ struct DpSwitch
             return;
          }
 
-         if (auto * dp_value = std::get_if<BoolDatapointValue>(&datapoint.value))
+         if (const auto dp_value = datapoint.get<BoolDatapointValue>())
          {
             if (!this->config_.matching_dp.allows_single_type())
             {
@@ -48,7 +47,7 @@ struct DpSwitch
             callback_(received_value_.value());
          }
          else
-         if (auto * dp_value = std::get_if<UIntDatapointValue>(&datapoint.value))
+         if (const auto dp_value = datapoint.get<UIntDatapointValue>())
          {
             if (!this->config_.matching_dp.allows_single_type())
             {
@@ -60,7 +59,7 @@ struct DpSwitch
             callback_(received_value_.value());
          }
          else
-         if (auto * dp_value = std::get_if<EnumDatapointValue>(&datapoint.value))
+         if (const auto dp_value = datapoint.get<EnumDatapointValue>())
          {
             if (!this->config_.matching_dp.allows_single_type())
             {
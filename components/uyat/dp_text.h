@@ -2,12 +2,12 @@
 
 #include "esphome/core/helpers.h"
 
-#include <functional>
 #include <string>
 #include <optional>
 
 #include "uyat_datapoint_types.h"
 #include "uyat_string.hpp"
+#include "uyat_delegate.hpp"
 
 namespace esphome::uyat
 {
@@ -38,7 +38,7 @@ struct DpText
 {
    static constexpr const char * TAG = "uyat.DpText";
 
-   using OnValueCallback = std::function<void(const StaticString&)>;
+   using OnValueCallback = Delegate<void(const StaticString&)>;
 
    struct Config
    {
@@ -54,7 +54,7 @@ struct DpText
    void init(DatapointHandler& handler)
    {
       this->handler_ = &handler;
-      this->handler_->register_datapoint_listener(this->config_.matching_dp, [this](const UyatDatapoint &datapoint) {
+      this->handler_->register_datapoint_listener(this->config_.matching_dp, [this](const DatapointView &datapoint) {
          ESP_LOGV(DpText::TAG, "%s processing as text_sensor", datapoint.to_string().c_str());
 
          if (!this->config_.matching_dp.matches(datapoint.get_type()))
@@ -63,26 +63,27 @@ struct DpText
             return;
          }
 
-         if (auto * dp_value = std::get_if<RawDatapointValue>(&datapoint.value))
+         if (const auto dp_value = datapoint.get_raw())
          {
             if (!this->config_.matching_dp.allows_single_type())
             {
                this->config_.matching_dp.types = {UyatDatapointType::RAW};
                ESP_LOGI(DpText::TAG, "Resolved %s", this->config_.matching_dp.to_string().c_str());
             }
-            this->last_received_value_ = StaticString(dp_value->value.begin(), dp_value->value.end());
+            this->last_received_value_ = StaticString(dp_value->begin(), dp_value->end());
             this->last_received_value_ = this->decode_(this->last_received_value_);
             callback_(this->last_received_value_);
          }
          else
-         if (auto * dp_value = std::get_if<StringDatapointValue>(&datapoint.value))
+         if (const auto dp_value = datapoint.get_string())
          {
             if (!this->config_.matching_dp.allows_single_type())
             {
                this->config_.matching_dp.types = {UyatDatapointType::STRING};
                ESP_LOGI(DpText::TAG, "Resolved %s", this->config_.matching_dp.to_string().c_str());
             }
-            this->last_received_value_ = this->decode_(dp_value->value);
+            this->last_received_value_ = StaticString(dp_value->begin(), dp_value->end());
+            this->last_received_value_ = this->decode_(this->last_received_value_);
             callback_(this->last_received_value_);
          }
          else
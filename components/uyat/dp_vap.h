@@ -1,9 +1,10 @@
 #pragma once
 
-#include <functional>
+#include <span>
 
 #include "uyat_datapoint_types.h"
 #include "uyat_string.hpp"
+#include "uyat_delegate.hpp"
 
 namespace esphome::uyat
 {
@@ -21,7 +22,7 @@ struct DpVAP
          return StringHelpers::sprintf("V: %u, A: %u, P: %u", v, a, p);
       }
    };
-   using OnValueCallback = std::function<void(const VAPValue&)>;
+   using OnValueCallback = Delegate<void(const VAPValue&)>;
 
    struct Config
    {
@@ -36,7 +37,7 @@ struct DpVAP
    void init(DatapointHandler& handler)
    {
       handler_ = &handler;
-      handler.register_datapoint_listener(this->config_.matching_dp, [this](const UyatDatapoint &datapoint) {
+      handler.register_datapoint_listener(this->config_.matching_dp, [this](const DatapointView &datapoint) {
          ESP_LOGV(DpVAP::TAG, "%s processing as VAP", datapoint.to_string().c_str());
 
          if (!this->config_.matching_dp.matches(datapoint.get_type()))
@@ -45,9 +46,9 @@ struct DpVAP
             return;
          }
 
-         if (auto * dp_value = std::get_if<RawDatapointValue>(&datapoint.value))
+         if (const auto dp_value = datapoint.get_raw())
          {
-            if (auto decoded = decode_(dp_value->value))
+            if (auto decoded = decode_(*dp_value))
             {
                this->received_value_ = decoded;
                callback_(received_value_.value());
@@ -85,7 +86,7 @@ struct DpVAP
 
 private:
 
-   std::optional<VAPValue> decode_(const std::vector<uint8_t>& raw_data) const
+   std::optional<VAPValue> decode_(const std::span<const uint8_t> raw_data) const
    {
       if (raw_data.size() != 8u)
       {
@@ -74,6 +74,8 @@ fan::FanTraits UyatFan::get_traits() {
 }
 
 void UyatFan::control(const fan::FanCall &call) {
+  DatapointBatch batch(this->parent_);
+
   if (this->dp_switch_.has_value() && call.get_state().has_value()) {
     this->dp_switch_->set_value(*call.get_state());
   }
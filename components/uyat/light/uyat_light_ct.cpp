@@ -67,6 +67,8 @@ light::LightTraits UyatLightCT::get_traits() {
 void UyatLightCT::setup_state(light::LightState *state) { state_ = state; }
 
 void UyatLightCT::write_state(light::LightState *state) {
+  DatapointBatch batch(this->parent_);
+
   float color_temperature = 0.0f, brightness = 0.0f;
   state->current_values_as_ct(&color_temperature, &brightness);
   if (!state->current_values.is_on()) {
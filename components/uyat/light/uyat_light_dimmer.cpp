@@ -56,6 +56,8 @@ light::LightTraits UyatLightDimmer::get_traits() {
 void UyatLightDimmer::setup_state(light::LightState *state) { state_ = state; }
 
 void UyatLightDimmer::write_state(light::LightState *state) {
+  DatapointBatch batch(this->parent_);
+
   float brightness = 0.0f;
 
   state->current_values_as_brightness(&brightness);
@@ -36,6 +36,8 @@ light::LightTraits UyatLightRGB::get_traits() {
 void UyatLightRGB::setup_state(light::LightState *state) { state_ = state; }
 
 void UyatLightRGB::write_state(light::LightState *state) {
+  DatapointBatch batch(this->parent_);
+
   float red = 0.0f, green = 0.0f, blue = 0.0f;
 
   state->current_values_as_rgb(&red, &green, &blue);
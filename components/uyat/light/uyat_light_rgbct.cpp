@@ -74,6 +74,8 @@ light::LightTraits UyatLightRGBCT::get_traits() {
 void UyatLightRGBCT::setup_state(light::LightState *state) { state_ = state; }
 
 void UyatLightRGBCT::write_state(light::LightState *state) {
+  DatapointBatch batch(this->parent_);
+
   float red = 0.0f, green = 0.0f, blue = 0.0f;
   float color_temperature = 0.0f, brightness = 0.0f;
 
@@ -66,6 +66,8 @@ light::LightTraits UyatLightRGBW::get_traits() {
 void UyatLightRGBW::setup_state(light::LightState *state) { state_ = state; }
 
 void UyatLightRGBW::write_state(light::LightState *state) {
+  DatapointBatch batch(this->parent_);
+
   float red = 0.0f, green = 0.0f, blue = 0.0f;
   float brightness = 0.0f;
 
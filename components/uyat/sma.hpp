@@ -1,15 +1,22 @@
 #pragma once
 
-#include <cstdint>
-#include <functional>
-#include <vector>
 #include <algorithm>
-#include <optional>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
 #include <span>
 
 namespace sma
 {
 
+// Two-level segregated fit allocator (TLSF) over a fixed buffer.
+// Every block starts with a 4-byte header: its size and the size of the block before it, so
+// the neighbours of a freed block are found directly and merged with it. Free blocks are kept in
+// lists by size class, a bitmap tells which lists are not empty. Allocation, free and the merging
+// all take constant time, no matter how many blocks there are.
+// Blocks are multiples of 4 bytes, so every allocation is 4-byte aligned. The buffer can have up to
+// 64kB, max_slots only limits how many allocations can exist at once.
 struct StaticMemoryAllocator
 {
 #ifdef SMA_ENABLE_STATS
@@ -23,11 +30,17 @@ struct StaticMemoryAllocator
 #endif
 
    explicit StaticMemoryAllocator(std::span<uint8_t> buffer, const std::size_t max_slots):
-   buffer_(buffer),
-   occupied_slots_(max_slots),
-   free_slots_(max_slots + 1u)
+   buffer_(buffer.first(std::min<std::size_t>(buffer.size(), MAX_BLOCK_SIZE) & ~(GRANULARITY - 1u))),
+   max_slots_(max_slots)
    {
-      free_slots_[0] = Slot{.used = true, .offset = 0, .size = buffer.size()};
+      heads_.fill(NONE);
+      if (buffer_.size() >= MIN_BLOCK_SIZE)
+      {
+         write_header(0u, static_cast<uint16_t>(buffer_.size()), true, 0u);
+         insert_free_block(0u);
+         total_free_ = buffer_.size();
+         num_free_blocks_ = 1u;
+      }
    }
 
    StaticMemoryAllocator(const StaticMemoryAllocator&) = delete;
@@ -43,279 +56,312 @@ struct StaticMemoryAllocator
    }
 #endif
 
+   // the biggest allocation that would succeed now
    std::size_t max_size() const
    {
+      if (fl_bitmap_ == 0u)
+      {
+         return 0u;
+      }
+      // the biggest blocks are in the highest non-empty list
+      const auto fl = static_cast<std::size_t>(std::bit_width(fl_bitmap_) - 1);
+      const auto sl = static_cast<std::size_t>(std::bit_width(sl_bitmaps_[fl]) - 1);
       std::size_t result = 0u;
-
-      for (auto & slot: free_slots_)
+      for (auto block = heads_[fl * SL_COUNT + sl]; block != NONE; block = next_free(block))
       {
-         if ((slot.used) && (slot.size > result))
-         {
-            result = slot.size;
-         }
+         result = std::max<std::size_t>(result, block_size(block));
       }
+      return result - HEADER_SIZE;
+   }
 
-      return result;
+   // true if the pointer points into the buffer
+   bool owns(const uint8_t* ptr) const
+   {
+      return (!buffer_.empty()) && (ptr >= buffer_.data()) && (ptr < (buffer_.data() + buffer_.size()));
    }
 
+   // bytes taken by the allocations, including their headers
    std::size_t total_occupied() const
    {
-      std::size_t result = 0u;
-      for (auto & slot: occupied_slots_)
-      {
-         if (slot.used)
-         {
-            result += slot.size;
-         }
-      }
-      return result;
+      return buffer_.size() - total_free_;
    }
 
    std::size_t total_free() const
    {
-      std::size_t result = 0u;
-      for (auto & slot: free_slots_)
-      {
-         if (slot.used)
-         {
-            result += slot.size;
-         }
-      }
-      return result;
+      return total_free_;
    }
 
    uint8_t* allocate(const std::size_t size)
    {
-      auto new_slot = find_empty_slot(occupied_slots_);
-      if (!new_slot)
+      if ((num_used_blocks_ >= max_slots_) || (size > (MAX_BLOCK_SIZE - HEADER_SIZE)))
       {
          return nullptr;
       }
 
-      auto selected_free_slot_index = select_free_slot_index(size);
-      if (!selected_free_slot_index)
+      const uint16_t needed = to_block_size(size);
+      const auto block = find_free_block(needed);
+      if (block == NONE)
       {
          return nullptr;
       }
 
-      auto & selected_free_slot = free_slots_[*selected_free_slot_index];
-      auto & occupied_slot = occupied_slots_[*new_slot];
-      occupied_slot = Slot{.used = true, .offset = selected_free_slot.offset, .size = size};
-      selected_free_slot.offset += size;
-      selected_free_slot.size -= size;
-      if (selected_free_slot.size == 0)
+      remove_free_block(block);
+      const uint16_t available = block_size(block);
+      if (static_cast<std::size_t>(available - needed) >= MIN_BLOCK_SIZE)
       {
-         selected_free_slot.used = 0;
+         // the rest stays free
+         const uint16_t rest = block + needed;
+         write_header(rest, available - needed, true, needed);
+         set_prev_size(rest + (available - needed), available - needed);
+         insert_free_block(rest);
+         write_header(block, needed, false, prev_size(block));
       }
+      else
+      {
+         write_header(block, available, false, prev_size(block));
+         --num_free_blocks_;
+      }
+      total_free_ -= block_size(block);
+      ++num_used_blocks_;
+
       update_stats();
-      return &buffer_[occupied_slot.offset];
+      return &buffer_[block + HEADER_SIZE];
    }
 
    void free(uint8_t* ptr)
    {
-      if ((ptr < &buffer_[0]) || (ptr >= &buffer_[buffer_.size()]))
+      if (!owns(ptr) || (ptr < &buffer_[HEADER_SIZE]))
       {
          // buffer out of range
          return;
       }
-      // find slot by pointer
-      // todo: binary search should be faster over bigger number of slots (only sorted!)
-      auto occupied_idx = find_occupied_slot_by_ptr(ptr);
-      if (!occupied_idx)
+      uint16_t block = static_cast<uint16_t>(ptr - buffer_.data() - HEADER_SIZE);
+      if (((block % GRANULARITY) != 0u) || is_free(block))
       {
+         // not an allocation
          return;
       }
 
-      // move to the free slots
-      auto new_slot = find_empty_slot(free_slots_);
-      free_slots_[*new_slot] = std::move(occupied_slots_[*occupied_idx]);
-      occupied_slots_[*occupied_idx].used = false;
+      uint16_t size = block_size(block);
+      total_free_ += size;
+      --num_used_blocks_;
+      ++num_free_blocks_;
 
-      // merge free slots if needed
-      merge_free_slots();
+      // merge with the free neighbours, there are never two free blocks next to each other
+      const uint16_t next = block + size;
+      if ((next < buffer_.size()) && is_free(next))
+      {
+         remove_free_block(next);
+         size += block_size(next);
+         --num_free_blocks_;
+      }
+      if ((block > 0u) && is_free(block - prev_size(block)))
+      {
+         const uint16_t prev = block - prev_size(block);
+         remove_free_block(prev);
+         size += block_size(prev);
+         block = prev;
+         --num_free_blocks_;
+      }
+
+      write_header(block, size, true, prev_size(block));
+      set_prev_size(block + size, size);
+      insert_free_block(block);
 
       update_stats();
    }
 
 private:
 
-   struct Slot
+   static constexpr uint16_t NONE = 0xFFFFu;
+   static constexpr std::size_t GRANULARITY = 4u;
+   static constexpr std::size_t HEADER_SIZE = 4u;
+   // a free block holds the links of its list after the header
+   static constexpr std::size_t MIN_BLOCK_SIZE = HEADER_SIZE + 4u;
+   static constexpr std::size_t MAX_BLOCK_SIZE = 0xFFFCu;
+
+   // sizes below SMALL_SIZE all go to the first level 0, every next level covers twice the sizes
+   // of the previous one, split into SL_COUNT lists
+   static constexpr std::size_t SL_LOG2 = 2u;
+   static constexpr std::size_t SL_COUNT = 1u << SL_LOG2;
+   static constexpr std::size_t SMALL_LOG2 = SL_LOG2 + 2u;
+   static constexpr std::size_t SMALL_SIZE = 1u << SMALL_LOG2;
+   static constexpr std::size_t FL_COUNT = 16u - SMALL_LOG2 + 1u;
+
+   struct SizeClass
    {
-      bool used = false;
-      std::size_t offset = 0;
-      std::size_t size = 0;
+      std::size_t fl;
+      std::size_t sl;
    };
 
-   bool is_slot_buffer(const Slot& slot, const uint8_t* ptr) const
+   static uint16_t to_block_size(const std::size_t size)
    {
-      if (!slot.used)
-      {
-         return false;
-      }
-
-      return (&buffer_[slot.offset] == ptr);
+      const std::size_t rounded = (std::max<std::size_t>(size, 1u) + GRANULARITY - 1u) & ~(GRANULARITY - 1u);
+      return static_cast<uint16_t>(std::max(rounded + HEADER_SIZE, MIN_BLOCK_SIZE));
    }
 
-   bool is_valid_slot(const Slot& slot) const
+   static SizeClass size_class(const std::size_t size)
    {
-      return (slot.offset + slot.size) <= buffer_.size();
+      if (size < SMALL_SIZE)
+      {
+         return SizeClass{.fl = 0u, .sl = size / (SMALL_SIZE / SL_COUNT)};
+      }
+      const std::size_t log2 = std::bit_width(size) - 1u;
+      return SizeClass{.fl = log2 - SMALL_LOG2 + 1u, .sl = (size >> (log2 - SL_LOG2)) & (SL_COUNT - 1u)};
    }
 
-   std::optional<std::size_t> find_empty_slot(const std::vector<Slot>& slots) const
+   uint16_t find_free_block(const uint16_t size) const
    {
-      for (std::size_t idx = 0; idx < slots.size(); ++idx)
+      // any block of the next class up fits
+      std::size_t search = size;
+      if (size >= SMALL_SIZE)
       {
-         if (!slots[idx].used)
+         search += (std::size_t{1u} << (std::bit_width(search) - 1u - SL_LOG2)) - 1u;
+      }
+      else
+      {
+         search += (SMALL_SIZE / SL_COUNT) - 1u;
+      }
+      const auto cls = size_class(search);
+      if (cls.fl < FL_COUNT)
+      {
+         uint32_t sl_map = sl_bitmaps_[cls.fl] & (~0u << cls.sl);
+         std::size_t fl = cls.fl;
+         if (sl_map == 0u)
+         {
+            const uint32_t fl_map = (fl + 1u < 32u) ? (fl_bitmap_ & (~0u << (fl + 1u))) : 0u;
+            if (fl_map != 0u)
+            {
+               fl = std::countr_zero(fl_map);
+               sl_map = sl_bitmaps_[fl];
+            }
+         }
+         if (sl_map != 0u)
          {
-            return idx;
+            return heads_[fl * SL_COUNT + std::countr_zero(sl_map)];
          }
       }
 
-      return std::nullopt;
+      // only the class of the size itself is left, some of its blocks may still fit
+      const auto own = size_class(size);
+      for (auto block = heads_[own.fl * SL_COUNT + own.sl]; block != NONE; block = next_free(block))
+      {
+         if (block_size(block) >= size)
+         {
+            return block;
+         }
+      }
+      return NONE;
    }
 
-   bool slots_overlap(const Slot& slot1, const Slot& slot2) const
+   void insert_free_block(const uint16_t block)
    {
-      if ((slot2.offset >= slot1.offset) && (slot2.offset < (slot1.offset + slot1.size)))
+      const auto cls = size_class(block_size(block));
+      auto& head = heads_[cls.fl * SL_COUNT + cls.sl];
+      set_links(block, head, NONE);
+      if (head != NONE)
       {
-         return true;
+         set_links(head, next_free(head), block);
       }
-      if ((slot1.offset >= slot2.offset) && (slot1.offset < (slot2.offset + slot2.size)))
+      head = block;
+      fl_bitmap_ |= (1u << cls.fl);
+      sl_bitmaps_[cls.fl] |= static_cast<uint8_t>(1u << cls.sl);
+   }
+
+   void remove_free_block(const uint16_t block)
+   {
+      const auto cls = size_class(block_size(block));
+      const auto next = next_free(block);
+      const auto prev = prev_free(block);
+      if (next != NONE)
       {
-         return true;
+         set_links(next, next_free(next), prev);
       }
-      if ((slot1.offset == slot2.offset) && (slot1.size == slot2.size))
+      if (prev != NONE)
       {
-         return true;
+         set_links(prev, next, prev_free(prev));
       }
-      return false;
-   }
-
-   std::optional<std::size_t> select_free_slot_index(const std::size_t size) const
-   {
-      std::optional<std::size_t> result;
-      for (std::size_t idx = 0; idx < free_slots_.size(); ++idx)
+      else
       {
-         auto & slot = free_slots_[idx];
-         if ((slot.used) && (slot.size >= size))
+         heads_[cls.fl * SL_COUNT + cls.sl] = next;
+         if (next == NONE)
          {
-            if (slot.size == size)
+            sl_bitmaps_[cls.fl] &= static_cast<uint8_t>(~(1u << cls.sl));
+            if (sl_bitmaps_[cls.fl] == 0u)
             {
-               return idx;
-            }
-            if ((!result) || (slot.size < free_slots_[*result].size))
-            {
-               result = idx;
+               fl_bitmap_ &= ~(1u << cls.fl);
             }
          }
       }
-
-      return result;
    }
 
-   std::optional<std::size_t> find_occupied_slot_by_ptr(const uint8_t* ptr) const
+   uint16_t read16(const std::size_t offset) const
    {
-      for (std::size_t idx = 0; idx < occupied_slots_.size(); ++idx)
-      {
-         auto & slot = occupied_slots_[idx];
-         if (is_slot_buffer(slot, ptr))
-         {
-            return idx;
-         }
-      }
-      return std::nullopt;
+      uint16_t value;
+      std::memcpy(&value, &buffer_[offset], sizeof(value));
+      return value;
    }
 
-   void merge_free_slots()
+   void write16(const std::size_t offset, const uint16_t value)
    {
-      // sort first
-      std::sort(free_slots_.begin(), free_slots_.end(), [](const auto& lhs, const auto& rhs){
-         if (!lhs.used)
-         {
-            return false;
-         }
+      std::memcpy(&buffer_[offset], &value, sizeof(value));
+   }
 
-         if (!rhs.used)
-         {
-            return true;
-         }
+   // header: size with the free flag in its lowest bit, size of the previous block
+   void write_header(const uint16_t block, const uint16_t size, const bool free, const uint16_t prev_size)
+   {
+      write16(block, size | (free? 1u : 0u));
+      write16(block + 2u, prev_size);
+   }
 
-         return lhs.offset < rhs.offset;
-      });
+   uint16_t block_size(const uint16_t block) const
+   {
+      return read16(block) & ~(GRANULARITY - 1u);
+   }
 
-      std::size_t current_idx = 0u;
-      while (current_idx < free_slots_.size())
-      {
-         auto & current = free_slots_[current_idx];
-         if (current.used)
-         {
-            std::size_t next_idx = current_idx + 1u;
-            while (next_idx < free_slots_.size())
-            {
-               auto & next = free_slots_[next_idx];
-               if (next.used)
-               {
-                  if (next.offset == (current.offset + current.size))
-                  {
-                     current.size += next.size;
-                     next.used = false;
-                  }
-               }
-               ++next_idx;
-            }
-         }
-         ++current_idx;
-      }
+   bool is_free(const uint16_t block) const
+   {
+      return (read16(block) & 1u) != 0u;
    }
 
-#ifdef SMA_ENABLE_STATS
-   std::size_t get_total_used_slots(const std::vector<Slot>& slots) const
+   uint16_t prev_size(const uint16_t block) const
    {
-      std::size_t result = 0;
+      return read16(block + 2u);
+   }
 
-      for (auto & slot: slots)
+   void set_prev_size(const uint16_t block, const uint16_t size)
+   {
+      if (block < buffer_.size())
       {
-         if (slot.used)
-         {
-            ++result;
-         }
+         write16(block + 2u, size);
       }
-
-      return result;
    }
 
-   void update_stats()
+   uint16_t next_free(const uint16_t block) const
    {
-      {
-         const auto allocated_size = total_occupied();
-         if (stats_.peak_allocated_size < allocated_size)
-         {
-            stats_.peak_allocated_size = allocated_size;
-         }
-      }
+      return read16(block + HEADER_SIZE);
+   }
 
-      {
-         const auto occupied_slots = get_total_used_slots(occupied_slots_);
-         if (stats_.peak_occupied_used_slots < occupied_slots)
-         {
-            stats_.peak_occupied_used_slots = occupied_slots;
-         }
-      }
+   uint16_t prev_free(const uint16_t block) const
+   {
+      return read16(block + HEADER_SIZE + 2u);
+   }
 
-      {
-         const auto free_slots = get_total_used_slots(free_slots_);
-         if (stats_.peak_occupied_free_slots < free_slots)
-         {
-            stats_.peak_occupied_free_slots = free_slots;
-         }
-      }
+   void set_links(const uint16_t block, const uint16_t next, const uint16_t prev)
+   {
+      write16(block + HEADER_SIZE, next);
+      write16(block + HEADER_SIZE + 2u, prev);
+   }
 
+#ifdef SMA_ENABLE_STATS
+   void update_stats()
+   {
+      stats_.peak_allocated_size = std::max(stats_.peak_allocated_size, total_occupied());
+      stats_.peak_occupied_used_slots = std::max(stats_.peak_occupied_used_slots, num_used_blocks_);
+      stats_.peak_occupied_free_slots = std::max(stats_.peak_occupied_free_slots, num_free_blocks_);
+      if (total_free_ > 0)
       {
-         const auto free_size = total_free();
-         if (free_size > 0)
-         {
-            stats_.fragmentation_index = static_cast<float>(max_size()) / free_size;
-         }
+         stats_.fragmentation_index = static_cast<float>(max_size()) / total_free_;
       }
    }
 #else
@@ -325,10 +371,14 @@ private:
 #endif
 
    std::span<uint8_t> buffer_;
-
-   // used memory slots
-   std::vector<Slot> occupied_slots_;
-   std::vector<Slot> free_slots_;
+   std::size_t max_slots_;
+   std::size_t num_used_blocks_{0u};
+   std::size_t num_free_blocks_{0u};
+   std::size_t total_free_{0u};
+
+   uint32_t fl_bitmap_{0u};
+   std::array<uint8_t, FL_COUNT> sl_bitmaps_{};
+   std::array<uint16_t, FL_COUNT * SL_COUNT> heads_{};
 
 #ifdef SMA_ENABLE_STATS
    Stats stats_{};
@@ -2,7 +2,9 @@
 
 #include <cstddef>
 #include <cstdlib>
+#include <limits>
 #include <memory>
+#include <new>
 
 #include "sma.hpp"
 
@@ -40,16 +42,26 @@ public:
     }
 
     inline pointer allocate(size_type cnt, const void* hint = 0) {
-        T *ptr = reinterpret_cast<T*>(sma_.allocate(cnt * sizeof(T)));
-        return ptr;
+        uint8_t *ptr = sma_.allocate(cnt * sizeof(T));
+        if (ptr == nullptr) {
+            // the pool is full
+            ptr = static_cast<uint8_t*>(::operator new(cnt * sizeof(T)));
+        }
+        return reinterpret_cast<T*>(ptr);
     }
 
     inline void deallocate(pointer p, size_type) {
-        sma_.free(reinterpret_cast<uint8_t*>(p));
+        uint8_t *ptr = reinterpret_cast<uint8_t*>(p);
+        if (sma_.owns(ptr)) {
+            sma_.free(ptr);
+        } else {
+            ::operator delete(ptr);
+        }
     }
 
+    // whatever doesn't fit the pool goes to the heap
     inline size_type max_size() const {
-        return sma_.max_size() / sizeof(T);
+        return std::numeric_limits<difference_type>::max() / sizeof(T);
     }
 
     inline void construct(pointer p, const T& t) {
@@ -8,14 +8,43 @@
 namespace esphome::uyat {
 
 static const char *const TAG = "uyat";
-static const int COMMAND_DELAY = 10;
-static const int RECEIVE_TIMEOUT = 300;
+// pause allowed between the bytes of a frame, on top of the time the missing bytes take on the wire
+static const uint32_t INTER_BYTE_TIMEOUT = 100;
 static const int MAX_RETRIES = 5;
+static const uint32_t MAX_RETRY_BACKOFF = 30000;
 
 static const uint8_t NET_STATUS_WIFI_CONNECTED = 0x03;
 static const uint8_t NET_STATUS_CLOUD_CONNECTED = 0x04;
 static const uint8_t FAKE_WIFI_RSSI = 100;
-static const uint64_t UART_MAX_POLL_TIME_MS = 50;
+
+// frames which never change are serialized at compile time
+static constexpr UyatCommand HEARTBEAT_COMMAND{UyatCommandType::HEARTBEAT};
+static constexpr UyatCommand PRODUCT_QUERY_COMMAND{UyatCommandType::PRODUCT_QUERY};
+static constexpr UyatCommand CONF_QUERY_COMMAND{UyatCommandType::CONF_QUERY};
+static constexpr UyatCommand DATAPOINT_QUERY_COMMAND{UyatCommandType::DATAPOINT_QUERY};
+static constexpr UyatCommand DATAPOINT_REPORT_ACK_COMMAND{UyatCommandType::DATAPOINT_REPORT_ACK, {0x01}};
+static constexpr UyatCommand WIFI_TEST_COMMAND{UyatCommandType::WIFI_TEST, {0x00, 0x00}};
+
+static optional<std::size_t> rtt_estimator_index(const UyatCommandType command) {
+  const auto it = std::find(RTT_TRACKED_COMMANDS.begin(), RTT_TRACKED_COMMANDS.end(), command);
+  if (it == RTT_TRACKED_COMMANDS.end()) {
+    return {};
+  }
+  return static_cast<std::size_t>(it - RTT_TRACKED_COMMANDS.begin());
+}
+
+static const char *queue_overflow_policy_to_string(const UyatQueueOverflowPolicy policy) {
+  switch (policy) {
+  case UyatQueueOverflowPolicy::DROP_OLDEST:
+    return "drop oldest";
+  case UyatQueueOverflowPolicy::DROP_NEWEST:
+    return "drop newest";
+  case UyatQueueOverflowPolicy::COALESCE:
+    return "coalesce";
+  default:
+    return "unknown";
+  }
+}
 
 #ifdef UYAT_DIAGNOSTICS_ENABLED
 static void add_unique_to_vector(std::vector<uint8_t> &vec, const uint8_t value) {
@@ -23,23 +52,39 @@ static void add_unique_to_vector(std::vector<uint8_t> &vec, const uint8_t value)
     vec.push_back(value);
   }
 }
-
-static bool remove_from_vector(std::vector<uint8_t> &vec, const uint8_t value) {
-  auto it = std::find(vec.begin(), vec.end(), value);
-  if (it != vec.end()) {
-    vec.erase(it);
-    return true;
-  }
-  return false;
-}
 #endif
 
 void Uyat::setup() {
+  this->init_phase_start_ = millis();
   schedule_heartbeat_(true);
   if (this->status_pin_ != nullptr) {
     this->status_pin_->digital_write(false);
   }
 
+  if (this->cache_handshake_) {
+    this->load_handshake_cache_();
+  }
+
+  if ((this->warm_start_backend_ == nullptr) && this->warm_start_storage_.has_value()) {
+    this->preferences_warm_start_backend_ = std::make_unique<PreferencesWarmStartBackend>(*this->warm_start_storage_);
+    this->warm_start_backend_ = this->preferences_warm_start_backend_.get();
+  }
+  if (this->warm_start_backend_ != nullptr) {
+    this->restore_warm_start_();
+    // snapshots are rate limited, so the flash isn't written on every report
+    this->set_interval("warm_start", this->warm_start_min_interval_ms_, [this] {
+      if (this->warm_start_dirty_) {
+        this->save_warm_start_();
+      }
+    });
+  }
+
+  if (this->notify_refresh_interval_ms_ > 0) {
+    // the next report of every datapoint reaches its listeners, changed or not
+    this->set_interval("notify_refresh", this->notify_refresh_interval_ms_,
+                       [this] { this->notified_since_refresh_.reset(); });
+  }
+
 #ifdef SMA_ENABLE_STATS
   this->set_interval("string_stats", 5000, [this] {
       {
@@ -49,19 +94,16 @@ void Uyat::setup() {
         ESP_LOGW(TAG, "strings: peak_occupied_used_slots: %zu", stats.peak_occupied_used_slots);
         ESP_LOGW(TAG, "strings: fragmentation_index: %.2f", stats.fragmentation_index);
       }
-      {
-        const auto stats = DequeMemoryPool::get_sma().get_stats();
-        ESP_LOGW(TAG, "deque: peak_allocated_size: %zu", stats.peak_allocated_size);
-        ESP_LOGW(TAG, "deque: peak_occupied_free_slots: %zu", stats.peak_occupied_free_slots);
-        ESP_LOGW(TAG, "deque: peak_occupied_used_slots: %zu", stats.peak_occupied_used_slots);
-        ESP_LOGW(TAG, "deque: fragmentation_index: %.2f", stats.fragmentation_index);
-      }
   });
 #endif
 
 #ifdef UYAT_DIAGNOSTICS_ENABLED
-  if ((this->num_garbage_bytes_sensor_) || (this->unknown_commands_text_sensor_) ||
-      (this->unknown_extended_commands_text_sensor_) || (this->unhandled_datapoints_text_sensor_))
+  if ((this->num_garbage_bytes_sensor_) || (this->num_poll_budget_hits_sensor_) || (this->num_expired_frames_sensor_) ||
+      (this->num_unconfirmed_writes_sensor_) ||
+      (this->command_queue_text_sensor_) ||
+      (this->num_dropped_commands_sensor_) || (this->command_queue_high_water_sensor_) ||
+      (this->unknown_commands_text_sensor_) || (this->unknown_extended_commands_text_sensor_) ||
+      (this->unhandled_datapoints_text_sensor_))
   {
     this->set_interval("diag_sensors_update", 1000, [this]{
       if (this->num_garbage_bytes_sensor_)
@@ -69,6 +111,46 @@ void Uyat::setup() {
         this->num_garbage_bytes_sensor_->publish_state(this->num_garbage_bytes_);
       }
 
+      if (this->num_poll_budget_hits_sensor_)
+      {
+        this->num_poll_budget_hits_sensor_->publish_state(this->num_poll_budget_hits_);
+      }
+
+      if (this->num_expired_frames_sensor_)
+      {
+        this->num_expired_frames_sensor_->publish_state(this->num_expired_frames_);
+      }
+
+      if (this->num_unconfirmed_writes_sensor_)
+      {
+        this->num_unconfirmed_writes_sensor_->publish_state(this->num_unconfirmed_writes_);
+      }
+
+      if (this->num_dropped_commands_sensor_)
+      {
+        this->num_dropped_commands_sensor_->publish_state(this->command_queue_.get_num_dropped());
+      }
+
+      if (this->command_queue_high_water_sensor_)
+      {
+        this->command_queue_high_water_sensor_->publish_state(this->command_queue_.get_high_water_mark());
+      }
+
+      if (this->command_queue_text_sensor_)
+      {
+        StaticString depths;
+        for (std::size_t i = 0; i < NUM_COMMAND_PRIORITIES; ++i)
+        {
+          const auto priority = static_cast<UyatCommandPriority>(i);
+          if (!depths.empty())
+          {
+            depths += " ";
+          }
+          depths += StringHelpers::sprintf("%s:%zu", UyatCommandQueue::priority_name(priority), this->command_queue_.size(priority));
+        }
+        this->command_queue_text_sensor_->publish_state(depths.c_str());
+      }
+
       if (this->unknown_commands_text_sensor_)
       {
         const auto cmd_ids = StringHelpers::format_hex_pretty(this->unknown_commands_set_, ' ', false);
@@ -83,7 +165,15 @@ void Uyat::setup() {
 
       if (this->unhandled_datapoints_text_sensor_)
       {
-        const auto dp_ids = StringHelpers::format_hex_pretty(this->unhandled_datapoints_set_, ' ', false);
+        std::vector<uint8_t> unhandled_ids;
+        for (std::size_t id = 0; id < this->unhandled_datapoints_set_.size(); ++id)
+        {
+          if (this->unhandled_datapoints_set_.test(id))
+          {
+            unhandled_ids.push_back(id);
+          }
+        }
+        const auto dp_ids = StringHelpers::format_hex_pretty(unhandled_ids, ' ', false);
         this->unhandled_datapoints_text_sensor_->publish_state(dp_ids.c_str());
       }
 
@@ -97,24 +187,140 @@ void Uyat::setup() {
 }
 
 void Uyat::loop() {
-  const auto start_ts = millis();
-  uint64_t now = start_ts;
-  auto number_of_bytes = this->available();
-  while (number_of_bytes > 0)
+  this->read_input_();
+  this->expire_partial_frame_();
+  this->write_tracker_.expire(millis());
+#ifdef UYAT_ASYNC_SUPPORTED
+  this->async_waiters_.expire(millis());
+#endif
+
+  // RX and TX take turns: a due command goes out after every handled frame instead of
+  // waiting for the whole input to be parsed, and the other way round. Each direction
+  // has its own budget, so neither can starve the other or hog the loop.
+  std::size_t frames_left = this->max_frames_per_loop_;
+  std::size_t commands_left = this->max_commands_per_loop_;
+  bool progress = true;
+  while (progress && ((frames_left > 0u) || (commands_left > 0u))) {
+    progress = false;
+    if ((frames_left > 0u) && this->handle_next_frame_()) {
+      --frames_left;
+      progress = true;
+    }
+    if ((commands_left > 0u) && this->process_command_queue_()) {
+      --commands_left;
+      progress = true;
+    }
+  }
+  if ((frames_left == 0u) && !this->rx_message_.empty()) {
+    ESP_LOGVV(TAG, "Frame budget exhausted, %zu bytes left for the next loop", this->rx_message_.size());
+  }
+}
+
+void Uyat::read_input_() {
+  const uint32_t start_ts = millis();
+  std::size_t bytes_read = 0u;
+  while (true)
   {
-    uint8_t c;
-    this->read_byte(&c);
-    this->rx_message_.buffer_.push_back(c);
-    this->last_rx_char_timestamp_ = millis();
-    if (now >= (start_ts + UART_MAX_POLL_TIME_MS))
+    const auto available = this->available();
+    if (available <= 0)
+    {
+      break;
+    }
+
+    // the time budget only counts after the first chunk, so something is read in every loop
+    if ((bytes_read >= this->max_uart_poll_bytes_) ||
+        ((bytes_read > 0u) && ((millis() - start_ts) >= this->max_uart_poll_time_ms_)))
+    {
+      // leave the rest for the next loop, so other components get their share of time
+#ifdef UYAT_DIAGNOSTICS_ENABLED
+      ++this->num_poll_budget_hits_;
+#endif
+      ESP_LOGVV(TAG, "UART poll budget exhausted after %zu bytes", bytes_read);
+      break;
+    }
+
+    auto free_space = this->rx_message_.write_span();
+    if (free_space.empty())
+    {
+      break;  // buffer is full, the pending bytes must be parsed first
+    }
+
+    const std::size_t to_read = std::min({free_space.size(),
+                                          static_cast<std::size_t>(available),
+                                          this->max_uart_poll_bytes_ - bytes_read});
+    if (!this->read_array(free_space.data(), to_read))
     {
       break;
     }
+    this->rx_message_.commit(to_read);
+    bytes_read += to_read;
+    this->last_rx_char_timestamp_ = millis();
+  }
+}
 
-    --number_of_bytes;
+void Uyat::on_shutdown() {
+  if ((this->warm_start_backend_ != nullptr) && this->warm_start_dirty_) {
+    this->save_warm_start_();
+  }
+}
+
+void Uyat::restore_warm_start_() {
+  WarmStartSnapshot snapshot{};
+  if (!this->warm_start_backend_->load(snapshot)) {
+    ESP_LOGD(TAG, "No warm start snapshot");
+    return;
+  }
+  if (!snapshot.is_valid()) {
+    ESP_LOGW(TAG, "Warm start snapshot is not valid, ignored");
+    return;
+  }
+
+  this->warm_start_sequence_ = snapshot.sequence;
+  for (uint8_t i = 0; i < snapshot.num_datapoints; i++) {
+    const auto &saved = snapshot.datapoints[i];
+    if (this->datapoint_cache_.contains(saved.number)) {
+      continue;
+    }
+    const std::span<const uint8_t> payload(saved.value, saved.length);
+    this->datapoint_cache_.store(saved.number, saved.type, payload);
+    this->provisional_datapoints_.set(saved.number);
+
+    // listeners registered from now on get it from the cache
+    const DatapointView datapoint{saved.number, saved.type, payload};
+    ESP_LOGD(TAG, "Restored %s (provisional)", datapoint.to_string().c_str());
+    const auto type_bit = MatchingDatapoint::get_type_bit(saved.type);
+    for (auto &listener : this->listeners_.for_datapoint(saved.number)) {
+      if (listener.type_mask & type_bit) {
+        listener.on_datapoint(datapoint);
+      }
+    }
+  }
+}
+
+void Uyat::save_warm_start_() {
+  WarmStartSnapshot snapshot{};
+  snapshot.sequence = ++this->warm_start_sequence_;
+  for (std::size_t id = 0; (id < 256) && (snapshot.num_datapoints < MAX_WARM_START_DATAPOINTS); id++) {
+    const auto type = this->datapoint_cache_.get_type(id);
+    const auto payload = this->datapoint_cache_.get_payload(id);
+    if (!type.has_value() || !payload.has_value() || !WarmStartSnapshot::can_store(*type, payload->size())) {
+      continue;
+    }
+    auto &saved = snapshot.datapoints[snapshot.num_datapoints++];
+    saved.number = id;
+    saved.type = *type;
+    saved.length = payload->size();
+    std::copy(payload->begin(), payload->end(), saved.value);
+  }
+
+  snapshot.seal();
+
+  if (this->warm_start_backend_->save(snapshot)) {
+    ESP_LOGV(TAG, "Warm start snapshot %" PRIu32 " saved, %u datapoints", snapshot.sequence, snapshot.num_datapoints);
+    this->warm_start_dirty_ = false;
+  } else {
+    ESP_LOGW(TAG, "Saving warm start snapshot failed");
   }
-  this->handle_input_buffer_();
-  process_command_queue_();
 }
 
 void Uyat::dump_config() {
@@ -133,8 +339,60 @@ void Uyat::dump_config() {
                        "is a supported Uyat device.");
   }
 
+  if (this->init_state_ == UyatInitState::INIT_DONE) {
+    ESP_LOGCONFIG(TAG, "  Initialized in %s", this->format_init_timing_().c_str());
+  }
+  if (this->cache_handshake_) {
+    ESP_LOGCONFIG(TAG, "  Handshake cache: %s", this->cached_handshake_.has_value() ? "valid" : "empty");
+  }
+
+  ESP_LOGCONFIG(TAG, "  UART poll budget: %" PRIu32 " ms, %zu bytes", this->max_uart_poll_time_ms_,
+                this->max_uart_poll_bytes_);
+  ESP_LOGCONFIG(TAG, "  Loop budget: %zu frames, %zu commands", this->max_frames_per_loop_,
+                this->max_commands_per_loop_);
+  ESP_LOGCONFIG(TAG, "  Init mode: %s, %zu commands in flight",
+                (this->init_mode_ == UyatInitMode::PIPELINED) ? "pipelined" : "serial",
+                UyatInFlightCommands::capacity());
+  ESP_LOGCONFIG(TAG, "  Writes in flight: %zu, confirmed by the %s", this->max_writes_in_flight_,
+                this->confirm_write_value_ ? "same value" : "same datapoint");
+  const auto &write_latency = this->write_tracker_.get_latency();
+  ESP_LOGCONFIG(TAG, "  Tracked writes: %zu, timeout %" PRIu32 " ms", WriteTracker::capacity(),
+                this->write_confirm_timeout_ms_);
+  if (write_latency.has_samples()) {
+    ESP_LOGCONFIG(TAG, "    confirmed after %.1f ms (+-%.1f ms, %" PRIu32 " writes)", write_latency.get_srtt(),
+                  write_latency.get_rttvar(), write_latency.get_num_samples());
+  }
+#ifdef UYAT_ASYNC_SUPPORTED
+  ESP_LOGCONFIG(TAG, "  Coroutine frames: %zu of %zu bytes", COROUTINE_FRAMES, COROUTINE_FRAME_SIZE);
+#endif
+  ESP_LOGCONFIG(TAG, "  Command queue: %zu commands, on overflow: %s", UyatCommandQueue::capacity(),
+                queue_overflow_policy_to_string(this->command_queue_.get_overflow_policy()));
+  ESP_LOGCONFIG(TAG, "  Response timeout: %" PRIu32 "-%" PRIu32 " ms, command delay: %" PRIu32 "-%" PRIu32 " ms",
+                this->min_response_timeout_ms_, this->max_response_timeout_ms_, this->min_command_delay_ms_,
+                this->max_command_delay_ms_);
+  for (std::size_t i = 0; i < RTT_TRACKED_COMMANDS.size(); i++) {
+    const auto &estimator = this->rtt_estimators_[i];
+    if (estimator.has_samples()) {
+      ESP_LOGCONFIG(TAG, "    CMD 0x%02X: rtt %.1f ms (+-%.1f ms, %" PRIu32 " samples), timeout %" PRIu32 " ms",
+                    static_cast<uint8_t>(RTT_TRACKED_COMMANDS[i]), estimator.get_srtt(), estimator.get_rttvar(),
+                    estimator.get_num_samples(), this->get_response_timeout_(RTT_TRACKED_COMMANDS[i]));
+    }
+  }
+
+  ESP_LOGCONFIG(TAG, "  String pool: %zu bytes, %zu free", StringMemoryPool::capacity(),
+                StringMemoryPool::get_sma().total_free());
+  ESP_LOGCONFIG(TAG, "  Datapoint cache: %zu datapoints, %zu retained in full", this->datapoint_cache_.size(),
+                this->datapoint_cache_.num_retained());
+  if (this->notify_on_change_only_.any()) {
+    ESP_LOGCONFIG(TAG, "  Notify on change only: %zu datapoints, refresh every %" PRIu32 " ms",
+                  this->notify_on_change_only_.count(), this->notify_refresh_interval_ms_);
+  }
+  if (this->warm_start_backend_ != nullptr) {
+    ESP_LOGCONFIG(TAG, "  Warm start: snapshot every %" PRIu32 " ms at most, %zu datapoints still provisional",
+                  this->warm_start_min_interval_ms_, this->provisional_datapoints_.count());
+  }
   ESP_LOGCONFIG(TAG, "  Listeners:");
-  for (const auto &dp : this->listeners_) {
+  for (const auto &dp : this->listeners_.all()) {
     ESP_LOGCONFIG(TAG, "    %s", dp.configured.to_string().c_str());
   }
 
@@ -148,92 +406,69 @@ void Uyat::dump_config() {
   }
 }
 
-std::size_t Uyat::validate_message_() {
-
-  const auto view = this->rx_message_.create_view();
-
-  if (view.size_ < (2u + 1u + 1u + 2u + 1u)) // header + version + command + length + checksum
-  {
-    return 0u;  // don't remove anything yet
-  }
-
-  if (view.byte_at(0u) != 0x55)
-  {
-    return 1u;
-  }
-
-  if (view.byte_at(1u) != 0xAA)
-  {
-    return 1u;  // remove just the first 0x55, in case it is followed by another 0x55
-  }
-
-  const uint8_t version = view.byte_at(2u);
-  const uint8_t command = view.byte_at(3u);
-  const uint16_t length = (uint16_t(view.byte_at(4u)) << 8) | (uint16_t(view.byte_at(5u)));
-  const auto checksum_offset = 6u + length;
-  if ((checksum_offset + 1u) > view.size_)  // offset of data field + length + checksum
-  {
-    return 0u;
+void Uyat::expire_partial_frame_() {
+  if (!this->frame_parser_.in_progress() || (millis() - this->last_rx_char_timestamp_ <= this->get_partial_frame_timeout_())) {
+    return;
   }
 
-  // Byte 6+LEN: CHECKSUM - sum of all bytes (including header) modulo 256
-  const uint8_t rx_checksum = view.byte_at(checksum_offset);
-  uint8_t calc_checksum = 0;
-  for (std::size_t i = 0; i < checksum_offset; ++i)
-    calc_checksum += view.byte_at(i);
+  ESP_LOGW(TAG, "Incomplete frame expired, %zu bytes missing", this->frame_parser_.missing_bytes());
+  FrameParser::Stats stats;
+  this->frame_parser_.abandon_frame(this->rx_message_, stats);
+#ifdef UYAT_DIAGNOSTICS_ENABLED
+  this->num_garbage_bytes_ += stats.dropped_bytes;
+  ++this->num_expired_frames_;
+#endif
+}
 
-  if (rx_checksum != calc_checksum) {
-    ESP_LOGW(TAG, "Received invalid message checksum %02X!=%02X",
-             rx_checksum, calc_checksum);
-    return 1u;
+uint32_t Uyat::get_partial_frame_timeout_() const {
+  const uint32_t baud_rate = this->parent_->get_baud_rate();
+  if (baud_rate == 0) {
+    return INTER_BYTE_TIMEOUT;
   }
-
-  // valid message
-  const size_t data_offset = 6u;
-  const size_t data_len = checksum_offset - data_offset;
-  ESP_LOGV(TAG, "Received Uyat: CMD=0x%02X VERSION=%u LEN=%zu INIT_STATE=%u",
-           command, version, data_len,
-           static_cast<uint8_t>(this->init_state_));
-  this->handle_command_(command, version, this->rx_message_.create_view(data_offset, data_len));
-
-  // the whole message can now be removed
-  return (checksum_offset + 1u);
+  // 10 bits per byte (start + 8 data + stop), rounded up
+  const uint32_t transfer_ms = (this->frame_parser_.missing_bytes() * 10u * 1000u + baud_rate - 1u) / baud_rate;
+  return INTER_BYTE_TIMEOUT + transfer_ms;
 }
 
-void Uyat::handle_input_buffer_() {
-  do
+bool Uyat::handle_next_frame_() {
+  while (!this->rx_message_.empty())
   {
-    auto bytes_to_remove = this->validate_message_();
-    if (bytes_to_remove == 0)
-    {
-      break;
+    FrameParser::Stats stats;
+    const auto frame = this->frame_parser_.parse(this->rx_message_, stats);
+    if (stats.checksum_errors > 0u) {
+      ESP_LOGW(TAG, "Received %zu message(s) with invalid checksum", stats.checksum_errors);
     }
-    if (bytes_to_remove > this->rx_message_.buffer_.size()) // just for safety, in case the validate_message_() is buggy
-    {
-      ESP_LOGW(TAG, "BUG: tryng to remove more bytes than possible %zu > %zu",
-        bytes_to_remove, this->rx_message_.buffer_.size());
-      bytes_to_remove = this->rx_message_.buffer_.size();
-    }
-
 #ifdef UYAT_DIAGNOSTICS_ENABLED
-    if (bytes_to_remove <= 1u)
+    this->num_garbage_bytes_ += stats.dropped_bytes;
+#endif
+    if (!frame.has_value())
     {
-      this->num_garbage_bytes_ += bytes_to_remove;
+      break;  // wait for more input
     }
-#endif
-    this->rx_message_.buffer_.erase(this->rx_message_.buffer_.begin(), this->rx_message_.buffer_.begin() + bytes_to_remove);
-  } while ((this->command_queue_.empty()) && (!this->rx_message_.buffer_.empty()));  // stop if there's message to be sent or no input
+
+    // the whole frame is here, get it as a contiguous block
+    const auto view = this->rx_message_.linear_view(0u, frame->total_size());
+    ESP_LOGV(TAG, "Received Uyat: CMD=0x%02X VERSION=%u LEN=%u INIT_STATE=%u",
+             frame->command, frame->version, frame->length,
+             static_cast<uint8_t>(this->init_state_));
+    this->handle_command_(frame->command, frame->version, view.create_view(FrameParser::HEADER_SIZE, frame->length));
+    this->rx_message_.consume(frame->total_size());
+    return true;
+  }
+  return false;
 }
 
 void Uyat::handle_command_(uint8_t command, uint8_t version,
-                           const StaticDeque::DequeView &view) {
+                           const ByteView &view) {
   UyatCommandType command_type = (UyatCommandType)command;
 
-  if (this->expected_response_.has_value() &&
-      this->expected_response_ == command_type) {
-    this->expected_response_.reset();
-    this->command_queue_.erase(command_queue_.begin());
-    this->init_retries_ = 0;
+  if (auto *in_flight = this->in_flight_.find(command_type)) {
+    if (!in_flight->resent) {
+      if (const auto idx = rtt_estimator_index(in_flight->command.cmd)) {
+        this->rtt_estimators_[*idx].add_sample(millis() - in_flight->sent_at);
+      }
+    }
+    this->in_flight_.remove(in_flight);
   }
 
   switch (command_type) {
@@ -245,92 +480,70 @@ void Uyat::handle_command_(uint8_t command, uint8_t version,
     }
     schedule_heartbeat_(false);
     if (this->init_state_ == UyatInitState::INIT_HEARTBEAT) {
-      this->init_state_ = UyatInitState::INIT_PRODUCT;
-      this->query_product_info_with_retries_();
+      if ((view.byte_at(0) != 0) && this->cached_handshake_.has_value()) {
+        // the MCU kept running, so it still has the same product and GPIO configuration:
+        // skip straight to the network status, the cache is checked once initialized
+        ESP_LOGI(TAG, "MCU did not restart, using the cached handshake");
+        const auto &cached = *this->cached_handshake_;
+        this->set_product_(StaticString(cached.product, cached.product + cached.product_length));
+        this->status_pin_reported_ = cached.status_pin;
+        this->reset_pin_reported_ = cached.reset_pin;
+        this->handshake_from_cache_ = true;
+        this->handshake_unconfirmed_ = true;
+        this->configure_network_();
+      } else {
+        this->set_init_state_(UyatInitState::INIT_PRODUCT);
+        this->query_product_info_with_retries_();
+      }
     }
     break;
   case UyatCommandType::PRODUCT_QUERY: {
     // check it is a valid string made up of printable characters
     bool valid = true;
-    for (size_t i = 0; i < view.size_; i++) {
+    for (size_t i = 0; i < view.size(); i++) {
       if (!std::isprint(view.byte_at(i))) {
         valid = false;
         break;
       }
     }
     if (valid) {
-      this->product_ = StaticString(view.cbegin(), view.cend());
-#ifdef UYAT_DIAGNOSTICS_ENABLED
-      if (this->product_text_sensor_)
-      {
-        this->product_text_sensor_->publish_state(this->product_.c_str());
-      }
-#endif
+      this->set_product_(StaticString(view.cbegin(), view.cend()));
     } else {
       this->product_ = R"({"p":"INVALID"})";
     }
 
     if (this->init_state_ == UyatInitState::INIT_PRODUCT) {
-      this->init_state_ = UyatInitState::INIT_CONF;
-      this->send_empty_command_(UyatCommandType::CONF_QUERY);
+      this->set_init_state_(UyatInitState::INIT_CONF);
+      if (this->init_mode_ == UyatInitMode::SERIAL) {
+        this->send_empty_command_(UyatCommandType::CONF_QUERY);
+      }
     }
     break;
   }
   case UyatCommandType::CONF_QUERY: {
-    if (view.size_ >= 2) {
+    const int cached_status_pin = this->status_pin_reported_;
+    const int cached_reset_pin = this->reset_pin_reported_;
+    if (view.size() >= 2) {
       this->status_pin_reported_ = view.byte_at(0);
       this->reset_pin_reported_ = view.byte_at(1);
     }
-    if (this->init_state_ == UyatInitState::INIT_CONF) {
-      // If mcu returned status gpio, then we can omit sending wifi state
-      if (this->status_pin_reported_ != -1) {
-        this->wifi_status_ = UyatNetworkStatus::CLOUD_CONNECTED;
-        this->init_state_ = UyatInitState::INIT_DATAPOINT;
-        this->send_empty_command_(UyatCommandType::DATAPOINT_QUERY);
-        bool is_pin_equals =
-            this->status_pin_ != nullptr &&
-            this->status_pin_->get_pin() == this->status_pin_reported_;
-        // Configure status pin toggling (if reported and configured) or
-        // WIFI_STATE periodic send
-        if (is_pin_equals) {
-          ESP_LOGV(TAG, "Configured status pin %i", this->status_pin_reported_);
-          this->defer([this] { this->set_status_pin_(); });
-        } else {
-          ESP_LOGW(TAG,
-                   "Supplied status_pin does not equals the reported pin %i. "
-                   "UyatMcu will work in limited mode.",
-                   this->status_pin_reported_);
-        }
+    // when pipelined, the configuration may come before the product info
+    const bool conf_awaited =
+        (this->init_state_ == UyatInitState::INIT_CONF) ||
+        ((this->init_mode_ == UyatInitMode::PIPELINED) && (this->init_state_ == UyatInitState::INIT_PRODUCT));
+    if (conf_awaited) {
+      this->handshake_from_cache_ = false;
+      this->handshake_unconfirmed_ = false;
+      this->save_handshake_cache_();
+      this->configure_network_();
+    } else if (this->handshake_unconfirmed_) {
+      this->handshake_unconfirmed_ = false;
+      this->save_handshake_cache_();
+      if ((this->status_pin_reported_ != cached_status_pin) || (this->reset_pin_reported_ != cached_reset_pin)) {
+        ESP_LOGW(TAG, "GPIO configuration differs from the cached one, repeating the network setup");
+        this->configure_network_();
       } else {
-
-        this->init_state_ = UyatInitState::INIT_WIFI;
-        if (this->requested_wifi_config_is_ap_.has_value())
-        {
-          if (this->requested_wifi_config_is_ap_.value())
-          {
-            this->wifi_status_ = UyatNetworkStatus::AP_MODE;
-          }
-          else
-          {
-            this->wifi_status_ = UyatNetworkStatus::SMARTCONFIG;
-          }
-        }
-        else
-        {
-          this->wifi_status_ = UyatNetworkStatus::WIFI_CONFIGURED;
-        }
-        this->requested_wifi_config_is_ap_.reset();
-#ifdef UYAT_DIAGNOSTICS_ENABLED
-        update_pairing_mode_sensor_();
-#endif
-
-        this->send_wifi_status_(static_cast<uint8_t>(this->wifi_status_));
-        this->wifi_status_ = UyatNetworkStatus::WIFI_CONNECTED;
-        this->send_wifi_status_(static_cast<uint8_t>(this->wifi_status_));
-        this->wifi_status_ = UyatNetworkStatus::CLOUD_CONNECTED;
-        this->send_wifi_status_(static_cast<uint8_t>(this->wifi_status_));
-        this->init_state_ = UyatInitState::INIT_DATAPOINT;
-        this->send_empty_command_(UyatCommandType::DATAPOINT_QUERY);
+        ESP_LOGD(TAG, "Cached handshake confirmed");
       }
     }
     break;
@@ -354,7 +567,7 @@ void Uyat::handle_command_(uint8_t command, uint8_t version,
       }
       else if (this->wifi_status_ == UyatNetworkStatus::CLOUD_CONNECTED)
       {
-        this->init_state_ = UyatInitState::INIT_DATAPOINT;
+        this->set_init_state_(UyatInitState::INIT_DATAPOINT);
         this->send_empty_command_(UyatCommandType::DATAPOINT_QUERY);
       }
     }
@@ -362,7 +575,7 @@ void Uyat::handle_command_(uint8_t command, uint8_t version,
   case UyatCommandType::WIFI_RESET:
   {
     ESP_LOGI(TAG, "WIFI_RESET");
-    this->init_state_ = UyatInitState::INIT_PRODUCT;
+    this->set_init_state_(UyatInitState::INIT_PRODUCT);
     this->send_empty_command_(UyatCommandType::WIFI_RESET);
     this->schedule_heartbeat_(true);
     this->query_product_info_with_retries_();
@@ -370,7 +583,7 @@ void Uyat::handle_command_(uint8_t command, uint8_t version,
   }
   case UyatCommandType::WIFI_SELECT: {
       ESP_LOGI(TAG, "WIFI_SELECT");
-      if (view.size_ > 0)
+      if (view.size() > 0)
       {
         this->requested_wifi_config_is_ap_ = (view.byte_at(0) == 0x01);
       }
@@ -383,7 +596,7 @@ void Uyat::handle_command_(uint8_t command, uint8_t version,
       update_pairing_mode_sensor_();
 #endif
 
-      this->init_state_ = UyatInitState::INIT_PRODUCT;
+      this->set_init_state_(UyatInitState::INIT_PRODUCT);
       this->send_empty_command_(UyatCommandType::WIFI_SELECT);
       this->schedule_heartbeat_(true);
       this->query_product_info_with_retries_();
@@ -394,30 +607,29 @@ void Uyat::handle_command_(uint8_t command, uint8_t version,
   case UyatCommandType::DATAPOINT_REPORT_ASYNC:
   case UyatCommandType::DATAPOINT_REPORT_SYNC:
     if (this->init_state_ == UyatInitState::INIT_DATAPOINT) {
-      this->init_state_ = UyatInitState::INIT_DONE;
+      this->set_init_state_(UyatInitState::INIT_DONE);
       this->set_timeout("datapoint_dump", 1000,
                         [this] { this->dump_config(); });
       this->initialized_callback_.call();
+      if (this->handshake_unconfirmed_) {
+        // lazily check that the cached handshake still holds, a mismatch is fixed up when the responses come
+        this->send_empty_command_(UyatCommandType::PRODUCT_QUERY);
+        this->send_empty_command_(UyatCommandType::CONF_QUERY);
+      }
     }
     this->handle_datapoints_(view);
 
     if (command_type == UyatCommandType::DATAPOINT_REPORT_SYNC) {
-      this->send_command_(
-          UyatCommand{.cmd = UyatCommandType::DATAPOINT_REPORT_ACK,
-                      .payload = std::vector<uint8_t>{0x01}});
+      this->send_command_(DATAPOINT_REPORT_ACK_COMMAND);
     }
     break;
   case UyatCommandType::DATAPOINT_QUERY:
     break;
   case UyatCommandType::WIFI_TEST:
-    this->send_command_(
-        UyatCommand{.cmd = UyatCommandType::WIFI_TEST,
-                    .payload = std::vector<uint8_t>{0x00, 0x00}});
+    this->send_command_(WIFI_TEST_COMMAND);
     break;
   case UyatCommandType::WIFI_RSSI:
-    this->send_command_(
-        UyatCommand{.cmd = UyatCommandType::WIFI_RSSI,
-                    .payload = std::vector<uint8_t>{get_wifi_rssi_()}});
+    this->send_command_(UyatCommand{UyatCommandType::WIFI_RSSI, {get_wifi_rssi_()}});
     break;
   case UyatCommandType::DISABLE_HEARTBEATS:
     stop_heartbeats_();
@@ -443,26 +655,21 @@ void Uyat::handle_command_(uint8_t command, uint8_t version,
     break;
 #endif
   // case UyatCommandType::VACUUM_MAP_UPLOAD:
-  //   this->send_command_(UyatCommand{.cmd = UyatCommandType::VACUUM_MAP_UPLOAD,
-  //                                   .payload = std::vector<uint8_t>{0x01}});
+  //   this->send_command_(UyatCommand{UyatCommandType::VACUUM_MAP_UPLOAD, {0x01}});
   //   ESP_LOGW(TAG,
   //            "Vacuum map upload requested, responding that it is not enabled.");
   //   break;
   case UyatCommandType::GET_NETWORK_STATUS: {
-    this->send_command_(
-        UyatCommand{.cmd = UyatCommandType::GET_NETWORK_STATUS,
-                    .payload = std::vector<uint8_t>{this->wifi_status_}});
+    this->send_command_(UyatCommand{UyatCommandType::GET_NETWORK_STATUS, {this->wifi_status_}});
     ESP_LOGV(TAG, "Network status requested, reported as %i", this->wifi_status_);
     break;
   }
   case UyatCommandType::GET_MAC_ADDRESS: {
-    std::vector<uint8_t> mac(6u);
-    get_mac_address_raw(mac.data());
-    this->send_command_(
-        UyatCommand{.cmd = UyatCommandType::GET_MAC_ADDRESS,
-                    .payload = mac});
+    uint8_t mac[6];
+    get_mac_address_raw(mac);
+    this->send_command_(UyatCommand{UyatCommandType::GET_MAC_ADDRESS, mac, sizeof(mac)});
     ESP_LOGV(TAG, "MAC address requested, reported as %s",
-              StringHelpers::format_hex_pretty(mac).c_str());
+              StringHelpers::format_hex_pretty(mac, sizeof(mac)).c_str());
     break;
   }
   case UyatCommandType::EXTENDED_SERVICES: {
@@ -470,11 +677,8 @@ void Uyat::handle_command_(uint8_t command, uint8_t version,
     switch ((UyatExtendedServicesCommandType)subcommand) {
     case UyatExtendedServicesCommandType::RESET_NOTIFICATION: {
       this->send_command_(UyatCommand{
-          .cmd = UyatCommandType::EXTENDED_SERVICES,
-          .payload = std::vector<uint8_t>{
-              static_cast<uint8_t>(
-                  UyatExtendedServicesCommandType::RESET_NOTIFICATION),
-              0x00}});
+          UyatCommandType::EXTENDED_SERVICES,
+          {static_cast<uint8_t>(UyatExtendedServicesCommandType::RESET_NOTIFICATION), 0x00}});
       ESP_LOGV(TAG, "Reset status notification enabled");
       break;
     }
@@ -487,30 +691,26 @@ void Uyat::handle_command_(uint8_t command, uint8_t version,
       break;
     }
     case UyatExtendedServicesCommandType::GET_MODULE_INFORMATION: {
-      std::vector<uint8_t> response_payload;
+      UyatCommand response{UyatCommandType::EXTENDED_SERVICES,
+                           {static_cast<uint8_t>(UyatExtendedServicesCommandType::GET_MODULE_INFORMATION)}};
       StaticString module_info_str;
-      response_payload.push_back(static_cast<uint8_t>(
-                  UyatExtendedServicesCommandType::GET_MODULE_INFORMATION));
-      if (view.size_ >= 2)
+      if (view.size() >= 2)
       {
-        module_info_str = process_get_module_information_(view.create_view(1u, view.size_ - 1u));
+        module_info_str = process_get_module_information_(view.create_view(1u, view.size() - 1u));
       }
 
-      if (module_info_str.empty())
+      if (module_info_str.empty() ||
+          ((module_info_str.size() + 1u) > (MAX_COMMAND_PAYLOAD_SIZE - response.payload_size())))
       {
-        response_payload.push_back(0x01);  // failure
+        response.append(0x01);  // failure
       }
       else
       {
-        response_payload.push_back(0x00);  // success
-        response_payload.insert(response_payload.end(),
-                                module_info_str.begin(),
-                                module_info_str.end());
+        response.append(0x00);  // success
+        response.append(reinterpret_cast<const uint8_t *>(module_info_str.data()), module_info_str.size());
       }
 
-      send_raw_command_(UyatCommand{
-          .cmd = UyatCommandType::EXTENDED_SERVICES,
-          .payload = response_payload});
+      send_raw_command_(response);
       break;
     }
     default:
@@ -530,12 +730,12 @@ void Uyat::handle_command_(uint8_t command, uint8_t version,
   }
 }
 
-void Uyat::handle_datapoints_(const StaticDeque::DequeView &buffer) {
-  auto len = buffer.size_;
+void Uyat::handle_datapoints_(const ByteView &buffer) {
+  auto len = buffer.size();
   auto offset = 0;
   while (len >= 4) {
     std::size_t used_len = 0u;
-    auto datapoint = UyatDatapoint::construct(buffer.create_view(offset, len), used_len);
+    const auto datapoint = DatapointView::parse(buffer.create_view(offset, len), used_len);
     if (used_len == 0u)
     {
       used_len = len;
@@ -547,8 +747,16 @@ void Uyat::handle_datapoints_(const StaticDeque::DequeView &buffer) {
     if (datapoint)
     {
       ESP_LOGD(TAG, "MCU reported %s", datapoint->to_string().c_str());
+#ifdef UYAT_ASYNC_SUPPORTED
+      this->async_waiters_.begin_report();
+#endif
+      this->confirm_datapoint_write_(*datapoint);
+      this->write_tracker_.on_report(*datapoint, millis());
+#ifdef UYAT_ASYNC_SUPPORTED
+      this->async_waiters_.on_report(*datapoint);
+#endif
       // drop update if datapoint is in ignore_mcu_datapoint_update list
-      if (this->ignore_mcu_update_on_datapoints_.end() != std::find(this->ignore_mcu_update_on_datapoints_.begin(), this->ignore_mcu_update_on_datapoints_.end(), datapoint->number))
+      if (this->ignore_mcu_update_on_datapoints_.test(datapoint->number))
       {
           ESP_LOGV(TAG,
                   "Datapoint %u found in ignore_mcu_update_on_datapoints list, "
@@ -557,22 +765,28 @@ void Uyat::handle_datapoints_(const StaticDeque::DequeView &buffer) {
       }
       else
       {
-        // Update internal datapoints
-        bool found = false;
-        for (auto &other : this->cached_datapoints_) {
-          if (other.matches(datapoint.value())) {
-            other = datapoint.value();
-            found = true;
-          }
+        bool changed = !this->datapoint_cache_.equals(datapoint->number, datapoint->type, datapoint->payload);
+        if (this->provisional_datapoints_.test(datapoint->number)) {
+          // the listeners got the restored value, make sure they get the real one too
+          this->provisional_datapoints_.reset(datapoint->number);
+          changed = true;
         }
-        if (!found) {
-          this->cached_datapoints_.push_back(datapoint.value());
+        this->datapoint_cache_.store(datapoint->number, datapoint->type, datapoint->payload);
+        this->warm_start_dirty_ |= changed;
+
+        if (!changed && this->notify_on_change_only_.test(datapoint->number) &&
+            this->notified_since_refresh_.test(datapoint->number))
+        {
+          ESP_LOGV(TAG, "Datapoint %u unchanged, listeners not notified", datapoint->number);
+          continue;
         }
+        this->notified_since_refresh_.set(datapoint->number);
 
-        // Run through listeners
+        // Run through listeners of this datapoint
+        const auto type_bit = MatchingDatapoint::get_type_bit(datapoint->type);
         bool handled = false;
-        for (auto &listener : this->listeners_) {
-          if (datapoint->matches(listener.configured))
+        for (auto &listener : this->listeners_.for_datapoint(datapoint->number)) {
+          if (listener.type_mask & type_bit)
           {
             listener.on_datapoint(datapoint.value());
             handled = true;
@@ -580,100 +794,274 @@ void Uyat::handle_datapoints_(const StaticDeque::DequeView &buffer) {
         }
 
 #ifdef UYAT_DIAGNOSTICS_ENABLED
-        if (!handled)
-        {
-          add_unique_to_vector(this->unhandled_datapoints_set_, datapoint->number);
-        }
-        else
-        {
-          (void) remove_from_vector(this->unhandled_datapoints_set_, datapoint->number);
-        }
+        this->unhandled_datapoints_set_.set(datapoint->number, !handled);
 #endif
       }
     }
   }
 }
 
-void Uyat::send_raw_command_(UyatCommand command) {
-  uint8_t len_hi = (uint8_t)(command.payload.size() >> 8);
-  uint8_t len_lo = (uint8_t)(command.payload.size() & 0xFF);
-  uint8_t version = 0;
-
+void Uyat::send_raw_command_(const UyatCommand &command) {
   this->last_command_timestamp_ = millis();
-  switch (command.cmd) {
-  case UyatCommandType::HEARTBEAT:
-    this->expected_response_ = UyatCommandType::HEARTBEAT;
-    break;
-  case UyatCommandType::PRODUCT_QUERY:
-    this->expected_response_ = UyatCommandType::PRODUCT_QUERY;
-    break;
-  case UyatCommandType::CONF_QUERY:
-    this->expected_response_ = UyatCommandType::CONF_QUERY;
-    break;
-  case UyatCommandType::DATAPOINT_DELIVER:
-  case UyatCommandType::DATAPOINT_QUERY:
-    this->expected_response_ = UyatCommandType::DATAPOINT_REPORT_ASYNC;
-    break;
-  default:
-    break;
-  }
 
-  ESP_LOGV(TAG, "Sending Uyat: CMD=0x%02X VERSION=%u DATA=[%s] INIT_STATE=%u",
-           static_cast<uint8_t>(command.cmd), version,
-           StringHelpers::format_hex_pretty(command.payload).c_str(),
+  ESP_LOGV(TAG, "Sending Uyat: CMD=0x%02X VERSION=0 DATA=[%s] INIT_STATE=%u",
+           static_cast<uint8_t>(command.cmd),
+           StringHelpers::format_hex_pretty(command.payload().data(), command.payload_size()).c_str(),
            static_cast<uint8_t>(this->init_state_));
 
-  this->write_array(
-      {0x55, 0xAA, version, (uint8_t)command.cmd, len_hi, len_lo});
-  if (!command.payload.empty())
-    this->write_array(command.payload.data(), command.payload.size());
-
-  uint8_t checksum = 0x55 + 0xAA + (uint8_t)command.cmd + len_hi + len_lo;
-  for (auto &data : command.payload)
-    checksum += data;
-  this->write_byte(checksum);
+  const auto frame = command.frame();
+  this->write_array(frame.data(), frame.size());
 }
 
-void Uyat::process_command_queue_() {
-  uint32_t now = millis();
-  uint32_t delay = now - this->last_command_timestamp_;
+bool Uyat::process_command_queue_() {
+  const uint32_t now = millis();
+  this->expire_in_flight_commands_(now);
+
+  // Left check of delay since last command in case there's ever a command sent
+  // by calling send_raw_command_ directly. A delay of 0 lets the next command out right away,
+  // even within the same millisecond.
+  if (now - this->last_command_timestamp_ < this->get_command_delay_()) {
+    return false;
+  }
 
-  if (now - this->last_rx_char_timestamp_ > RECEIVE_TIMEOUT) {
-    this->rx_message_.buffer_.clear();
+  for (auto &entry : this->in_flight_) {
+    if (!entry.awaiting && (now - entry.sent_at >= entry.backoff_ms)) {
+      this->send_raw_command_(entry.command);
+      entry.sent_at = now;
+      entry.awaiting = true;
+      return true;
+    }
   }
 
-  if (this->expected_response_.has_value() && delay > RECEIVE_TIMEOUT) {
-    this->expected_response_.reset();
-    if (init_state_ != UyatInitState::INIT_DONE) {
-      if (++this->init_retries_ >= MAX_RETRIES) {
-        this->init_failed_ = true;
-        ESP_LOGE(TAG, "Initialization failed at init_state %u",
-                 static_cast<uint8_t>(this->init_state_));
-        this->command_queue_.erase(command_queue_.begin());
-        this->init_retries_ = 0;
+  const auto *next = this->command_queue_.peek();
+  if (next == nullptr) {
+    return false;
+  }
+  const auto response = expected_response_to(next->cmd);
+  // only commands expecting a response wait for a free in-flight place, replies to the mcu and other
+  // commands it doesn't answer go out right away
+  if (response.has_value() && (this->in_flight_.size() >= this->get_max_in_flight_())) {
+    return false;
+  }
+  if (response.has_value() && this->in_flight_.conflicts(*next, *response)) {
+    return false;
+  }
+
+  // sent straight from the queue slot, only a command awaiting its response is copied (to in_flight_)
+  this->send_raw_command_(*next);
+  if (next->cmd == UyatCommandType::DATAPOINT_DELIVER) {
+    this->write_tracker_.on_sent(next->datapoint_ids().span(), now);
+  }
+  if (response.has_value()) {
+    this->in_flight_.add(*next, *response, now);
+  }
+  this->command_queue_.pop();
+  return true;
+}
+
+void Uyat::expire_in_flight_commands_(const uint32_t now) {
+  for (auto *entry = this->in_flight_.end(); entry-- != this->in_flight_.begin();) {
+    const uint32_t response_timeout = this->get_response_timeout_(entry->command.cmd);
+    if (!entry->awaiting || (now - entry->sent_at <= response_timeout)) {
+      continue;
+    }
+    // only the handshake commands are retried, a datapoint write is given up whatever the init state
+    if ((this->init_state_ == UyatInitState::INIT_DONE) || UyatInFlightCommands::is_write(*entry)) {
+      if (UyatInFlightCommands::is_write(*entry)) {
+        ESP_LOGD(TAG, "Write not confirmed in time, %zu datapoint(s) not reported", entry->unconfirmed.size());
+#ifdef UYAT_DIAGNOSTICS_ENABLED
+        ++this->num_unconfirmed_writes_;
+#endif
       }
+      this->in_flight_.remove(entry);
+      continue;
+    }
+
+    // a late response could belong to either copy
+    entry->resent = true;
+    if (++entry->attempts < MAX_RETRIES) {
+      // the command is sent again, after a backoff
+      entry->awaiting = false;
+      entry->sent_at = now;
+      entry->backoff_ms = this->get_retry_backoff_(response_timeout, entry->attempts - 1);
+      continue;
+    }
+
+    const auto command = entry->command.cmd;
+    this->in_flight_.remove(entry);
+    if ((command == UyatCommandType::PRODUCT_QUERY) && (this->init_state_ > UyatInitState::INIT_PRODUCT)) {
+      // pipelined: the initialization went on without it
+      ESP_LOGW(TAG, "No response to PRODUCT_QUERY");
+    } else if (this->handshake_unconfirmed_) {
+      // maybe the MCU does want the queries after all, do the full handshake
+      ESP_LOGW(TAG, "No response after the cached handshake, starting over with PRODUCT_QUERY");
+      this->handshake_from_cache_ = false;
+      this->handshake_unconfirmed_ = false;
+      this->in_flight_.clear();
+      this->set_init_state_(UyatInitState::INIT_PRODUCT);
+      this->defer([this] { this->query_product_info_with_retries_(); });
+      return;
     } else {
-      this->command_queue_.erase(command_queue_.begin());
+      this->init_failed_ = true;
+      ESP_LOGE(TAG, "Initialization failed at init_state %u",
+               static_cast<uint8_t>(this->init_state_));
     }
   }
+}
 
-  // Left check of delay since last command in case there's ever a command sent
-  // by calling send_raw_command_ directly
-  if (delay > COMMAND_DELAY && !this->command_queue_.empty() &&
-      this->rx_message_.buffer_.empty() && !this->expected_response_.has_value()) {
-    this->send_raw_command_(command_queue_.front());
-    if (!this->expected_response_.has_value())
-      this->command_queue_.erase(command_queue_.begin());
+std::size_t Uyat::get_max_in_flight_() const {
+  if (this->init_state_ != UyatInitState::INIT_DONE) {
+    return (this->init_mode_ == UyatInitMode::PIPELINED) ? UyatInFlightCommands::capacity() : 1u;
+  }
+  return std::clamp<std::size_t>(this->max_writes_in_flight_, 1u, UyatInFlightCommands::capacity());
+}
+
+void Uyat::confirm_datapoint_write_(const DatapointView &datapoint) {
+  for (auto *entry = this->in_flight_.end(); entry-- != this->in_flight_.begin();) {
+    if (!UyatInFlightCommands::is_write(*entry) || !entry->unconfirmed.contains(datapoint.number)) {
+      continue;
+    }
+    if (this->confirm_write_value_) {
+      const auto record = entry->command.find_datapoint_record(datapoint.number);
+      if (((*record)[1] != static_cast<uint8_t>(datapoint.type)) ||
+          !same_datapoint_value(datapoint.type, record->subspan(4u), datapoint.payload)) {
+        ESP_LOGV(TAG, "Datapoint %u reported with another value than written", datapoint.number);
+        continue;
+      }
+    }
+
+    entry->unconfirmed.remove(datapoint.number);
+    if (entry->unconfirmed.empty()) {
+      const uint32_t latency = millis() - entry->sent_at;
+      ESP_LOGV(TAG, "Write confirmed after %" PRIu32 " ms", latency);
+      if (!entry->resent) {
+        if (const auto idx = rtt_estimator_index(entry->command.cmd)) {
+          this->rtt_estimators_[*idx].add_sample(latency);
+        }
+      }
+      this->in_flight_.remove(entry);
+    }
+  }
+}
+
+uint32_t Uyat::get_response_timeout_(const UyatCommandType command) const {
+  if (const auto idx = rtt_estimator_index(command)) {
+    return this->rtt_estimators_[*idx].get_timeout(this->min_response_timeout_ms_, this->max_response_timeout_ms_);
+  }
+  return this->max_response_timeout_ms_;
+}
+
+uint32_t Uyat::get_command_delay_() const {
+  optional<float> fastest_rtt{};
+  for (const auto &estimator : this->rtt_estimators_) {
+    if (estimator.has_samples() && (!fastest_rtt.has_value() || (estimator.get_srtt() < *fastest_rtt))) {
+      fastest_rtt = estimator.get_srtt();
+    }
+  }
+  if (!fastest_rtt.has_value()) {
+    return this->max_command_delay_ms_;
   }
+  // a quarter of the round trip is plenty for the MCU to get ready for the next frame
+  const auto delay = static_cast<uint32_t>(*fastest_rtt / 4.0f);
+  return std::clamp(delay, this->min_command_delay_ms_, std::max(this->min_command_delay_ms_, this->max_command_delay_ms_));
+}
+
+uint32_t Uyat::get_retry_backoff_(const uint32_t base_ms, const int attempt) const {
+  const uint32_t backoff = std::min<uint32_t>(base_ms << std::clamp(attempt, 0, 8), MAX_RETRY_BACKOFF);
+  return backoff + random_uint32() % (backoff / 2u + 1u);
 }
 
 void Uyat::send_command_(const UyatCommand &command) {
-  command_queue_.push_back(command);
+  switch (this->command_queue_.push(command)) {
+  case UyatCommandQueue::PushResult::DROPPED_OLDEST:
+    ESP_LOGW(TAG, "Command queue full, dropped the oldest datapoint write");
+    break;
+  case UyatCommandQueue::PushResult::DROPPED_NEWEST:
+    ESP_LOGW(TAG, "Command queue full, dropped command 0x%02X", static_cast<uint8_t>(command.cmd));
+    break;
+  case UyatCommandQueue::PushResult::COALESCED:
+    ESP_LOGV(TAG, "Command queue full, datapoints merged into a queued write");
+    break;
+  default:
+    break;
+  }
   process_command_queue_();
 }
 
+std::size_t Uyat::get_command_queue_depth(const UyatCommandPriority priority) const {
+  return this->command_queue_.size(priority);
+}
+
 void Uyat::send_empty_command_(UyatCommandType command) {
-  send_command_(UyatCommand{.cmd = command, .payload = std::vector<uint8_t>{}});
+  switch (command) {
+  case UyatCommandType::HEARTBEAT:
+    send_command_(HEARTBEAT_COMMAND);
+    break;
+  case UyatCommandType::PRODUCT_QUERY:
+    send_command_(PRODUCT_QUERY_COMMAND);
+    break;
+  case UyatCommandType::CONF_QUERY:
+    send_command_(CONF_QUERY_COMMAND);
+    break;
+  case UyatCommandType::DATAPOINT_QUERY:
+    send_command_(DATAPOINT_QUERY_COMMAND);
+    break;
+  default:
+    send_command_(UyatCommand{command});
+    break;
+  }
+}
+
+void Uyat::configure_network_() {
+  // If mcu returned status gpio, then we can omit sending wifi state
+  if (this->status_pin_reported_ != -1) {
+    this->wifi_status_ = UyatNetworkStatus::CLOUD_CONNECTED;
+    this->set_init_state_(UyatInitState::INIT_DATAPOINT);
+    this->send_empty_command_(UyatCommandType::DATAPOINT_QUERY);
+    bool is_pin_equals =
+        this->status_pin_ != nullptr &&
+        this->status_pin_->get_pin() == this->status_pin_reported_;
+    // Configure status pin toggling (if reported and configured) or
+    // WIFI_STATE periodic send
+    if (is_pin_equals) {
+      ESP_LOGV(TAG, "Configured status pin %i", this->status_pin_reported_);
+      this->defer([this] { this->set_status_pin_(); });
+    } else {
+      ESP_LOGW(TAG,
+               "Supplied status_pin does not equals the reported pin %i. "
+               "UyatMcu will work in limited mode.",
+               this->status_pin_reported_);
+    }
+  } else {
+    this->set_init_state_(UyatInitState::INIT_WIFI);
+    if (this->requested_wifi_config_is_ap_.has_value())
+    {
+      if (this->requested_wifi_config_is_ap_.value())
+      {
+        this->wifi_status_ = UyatNetworkStatus::AP_MODE;
+      }
+      else
+      {
+        this->wifi_status_ = UyatNetworkStatus::SMARTCONFIG;
+      }
+    }
+    else
+    {
+      this->wifi_status_ = UyatNetworkStatus::WIFI_CONFIGURED;
+    }
+    this->requested_wifi_config_is_ap_.reset();
+#ifdef UYAT_DIAGNOSTICS_ENABLED
+    update_pairing_mode_sensor_();
+#endif
+
+    this->send_wifi_status_(static_cast<uint8_t>(this->wifi_status_));
+    this->wifi_status_ = UyatNetworkStatus::WIFI_CONNECTED;
+    this->send_wifi_status_(static_cast<uint8_t>(this->wifi_status_));
+    this->wifi_status_ = UyatNetworkStatus::CLOUD_CONNECTED;
+    this->send_wifi_status_(static_cast<uint8_t>(this->wifi_status_));
+    this->set_init_state_(UyatInitState::INIT_DATAPOINT);
+    this->send_empty_command_(UyatCommandType::DATAPOINT_QUERY);
+  }
 }
 
 void Uyat::set_status_pin_() {
@@ -684,13 +1072,12 @@ uint8_t Uyat::get_wifi_rssi_() { return FAKE_WIFI_RSSI; }
 
 void Uyat::send_wifi_status_(const uint8_t status) {
   ESP_LOGD(TAG, "Sending WiFi Status %d", status);
-  this->send_command_(UyatCommand{.cmd = UyatCommandType::WIFI_STATE,
-                                  .payload = std::vector<uint8_t>{status}});
+  this->send_command_(UyatCommand{UyatCommandType::WIFI_STATE, {status}});
 }
 
 #ifdef USE_TIME
 void Uyat::send_local_time_() {
-  std::vector<uint8_t> payload;
+  UyatCommand command{UyatCommandType::LOCAL_TIME_QUERY};
   ESPTime now = this->time_id_->now();
   if (now.is_valid()) {
     uint8_t year = now.year - 2000;
@@ -705,58 +1092,189 @@ void Uyat::send_local_time_() {
       day_of_week = 7;
     }
     ESP_LOGD(TAG, "Sending local time");
-    payload = std::vector<uint8_t>{0x01, year,   month,  day_of_month,
-                                   hour, minute, second, day_of_week};
+    for (const uint8_t value : {uint8_t(0x01), year, month, day_of_month, hour, minute, second, day_of_week}) {
+      command.append(value);
+    }
   } else {
     // By spec we need to notify MCU that the time was not obtained if this is a
     // response to a query
     ESP_LOGW(TAG, "Sending missing local time");
-    payload =
-        std::vector<uint8_t>{0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+    for (std::size_t i = 0; i < 8u; ++i) {
+      command.append(0x00);
+    }
   }
-  this->send_command_(UyatCommand{.cmd = UyatCommandType::LOCAL_TIME_QUERY,
-                                  .payload = payload});
+  this->send_command_(command);
 }
 #endif
 
-void Uyat::set_datapoint_value(const UyatDatapoint& dp, const bool forced ) {
+void Uyat::set_datapoint_value(const UyatDatapoint& dp, const bool forced) {
+  this->set_datapoint_value_(dp, forced);
+}
+
+WriteHandle Uyat::write_datapoint_value(const UyatDatapoint& dp, const OnWriteCompleteCallback& on_complete,
+                                        const uint32_t timeout_ms, const bool forced) {
+  const auto payload = dp.value_to_payload();
+  const auto handle = this->write_tracker_.track(dp.number, dp.get_type(), payload,
+                                                 (timeout_ms > 0) ? timeout_ms : this->write_confirm_timeout_ms_,
+                                                 on_complete, millis());
+  const auto outcome = this->set_datapoint_value_(dp, forced);
+  const auto result = (outcome == SetValueOutcome::NOT_SENT)    ? UyatWriteResult::NOT_SENT
+                      : (outcome == SetValueOutcome::UNCHANGED) ? UyatWriteResult::CONFIRMED
+                                                                : UyatWriteResult::UNTRACKED;
+  if (!handle.is_valid()) {
+    if (result == UyatWriteResult::UNTRACKED) {
+      ESP_LOGW(TAG, "Too many writes waiting for confirmation, datapoint %u sent untracked", dp.number);
+    }
+    // the caller gets the handle first, only then the result
+    this->defer([on_complete, result] { on_complete(WriteHandle{}, result, 0); });
+    return handle;
+  }
+
+  if (outcome != SetValueOutcome::SENT) {
+    this->defer([this, handle, result] { this->write_tracker_.complete(handle, result); });
+  }
+  return handle;
+}
+
+UyatWriteResult Uyat::get_write_result(const WriteHandle handle) const {
+  return this->write_tracker_.get_result(handle);
+}
+
+#ifdef UYAT_ASYNC_SUPPORTED
+NextReportAwaiter Uyat::next_report(const uint8_t datapoint_id, const uint32_t timeout_ms) {
+  return NextReportAwaiter(this->async_waiters_, datapoint_id, timeout_ms, millis());
+}
+
+ValueAwaiter Uyat::wait_for_value(const UyatDatapoint &value, const uint32_t timeout_ms) {
+  const auto cached = this->datapoint_cache_.get_payload(value.number);
+  const bool already_set = cached.has_value() && (this->datapoint_cache_.get_type(value.number) == value.get_type()) &&
+                           same_datapoint_value(value.get_type(), value.value_to_payload(), *cached);
+  return ValueAwaiter(this->async_waiters_, value, already_set, timeout_ms, millis());
+}
+
+DelayAwaiter Uyat::async_delay(const uint32_t delay_ms) {
+  return DelayAwaiter(this->async_waiters_, delay_ms, millis());
+}
+#endif
+
+Uyat::SetValueOutcome Uyat::set_datapoint_value_(const UyatDatapoint& dp, const bool forced) {
   ESP_LOGD(TAG, "Setting %s", dp.to_string().c_str());
-  auto configured_datapoint = this->get_datapoint_(dp.number);
-  if (configured_datapoint.has_value()) {
-    if (configured_datapoint->get_type() != dp.get_type())
+  const auto cached_type = this->datapoint_cache_.get_type(dp.number);
+  if (cached_type.has_value()) {
+    if (*cached_type != dp.get_type())
     {
       ESP_LOGE(TAG, "Datapoint %u previously seen as %s setting as %s",
-              dp.number, configured_datapoint->get_type_name(), dp.get_type_name());
+              dp.number, MatchingDatapoint::get_type_name(*cached_type), dp.get_type_name());
     }
-    if (!forced && dp.value == configured_datapoint->value) {
-      ESP_LOGV(TAG, "Not sending unchanged value");
-      return;
+  }
+
+  const auto payload = dp.value_to_payload();
+  // a batched or queued write is newer than what the mcu reported, so compare against the newest one
+  optional<std::span<const uint8_t>> pending_record{};
+  if (this->batch_command_.has_value()) {
+    pending_record = this->batch_command_->find_datapoint_record(dp.number);
+  }
+  if (!pending_record.has_value()) {
+    if (const auto *pending = this->find_pending_datapoint_write_(dp.number)) {
+      pending_record = pending->find_datapoint_record(dp.number);
     }
   }
 
-  this->send_datapoint_command_(dp.number, dp.get_type(), dp.value_to_payload());
-}
+  if (pending_record.has_value()) {
+    const auto pending_value = pending_record->subspan(4u);
+    if (!forced && ((*pending_record)[1] == static_cast<uint8_t>(dp.get_type())) &&
+        std::equal(pending_value.begin(), pending_value.end(), payload.begin(), payload.end())) {
+      ESP_LOGV(TAG, "Not sending value equal to the queued one");
+      return SetValueOutcome::SENT;
+    }
+  } else if (!forced && !this->provisional_datapoints_.test(dp.number) &&
+             this->datapoint_cache_.equals(dp.number, dp.get_type(), payload)) {
+    ESP_LOGV(TAG, "Not sending unchanged value");
+    return SetValueOutcome::UNCHANGED;
+  }
 
-optional<UyatDatapoint> Uyat::get_datapoint_(uint8_t datapoint_id) {
-  for (auto &datapoint : this->cached_datapoints_) {
-    if (datapoint.number == datapoint_id)
-      return datapoint;
+  if (!this->send_datapoint_command_(dp.number, dp.get_type(), payload)) {
+    return SetValueOutcome::NOT_SENT;
   }
-  return {};
+  return SetValueOutcome::SENT;
 }
 
-void Uyat::send_datapoint_command_(uint8_t datapoint_id,
+bool Uyat::send_datapoint_command_(uint8_t datapoint_id,
                                    UyatDatapointType datapoint_type,
-                                   std::vector<uint8_t> data) {
-  std::vector<uint8_t> buffer;
-  buffer.push_back(datapoint_id);
-  buffer.push_back(static_cast<uint8_t>(datapoint_type));
-  buffer.push_back(data.size() >> 8);
-  buffer.push_back(data.size() >> 0);
-  buffer.insert(buffer.end(), data.begin(), data.end());
+                                   const std::vector<uint8_t> &data) {
+  UyatCommand command{UyatCommandType::DATAPOINT_DELIVER,
+                      {datapoint_id, static_cast<uint8_t>(datapoint_type),
+                       static_cast<uint8_t>(data.size() >> 8), static_cast<uint8_t>(data.size() >> 0)}};
+  if (!command.append(data.data(), data.size())) {
+    ESP_LOGE(TAG, "Datapoint %u value too long (%zu bytes), not sent", datapoint_id, data.size());
+    return false;
+  }
+
+  if (this->batch_depth_ == 0u) {
+    this->queue_datapoint_frame_(command);
+    return true;
+  }
 
-  this->send_command_(UyatCommand{.cmd = UyatCommandType::DATAPOINT_DELIVER,
-                                  .payload = buffer});
+  if (!this->batch_command_.has_value()) {
+    this->batch_command_.emplace(UyatCommandType::DATAPOINT_DELIVER);
+  }
+
+  // the same datapoint set again within the batch replaces the older value
+  if (!this->batch_command_->merge_datapoint_record(command.payload())) {
+    // batch is full, send what is there and continue with a new one
+    this->queue_datapoint_frame_(*this->batch_command_);
+    this->batch_command_ = command;
+  }
+  return true;
+}
+
+void Uyat::queue_datapoint_frame_(const UyatCommand &command) {
+  if (command.payload_size() == 0u) {
+    return;
+  }
+
+  // last writer wins: the value replaces the one in the newest write of the datapoint which was not
+  // sent yet, no later queued frame writes it, so the mcu ends up with this value
+  if (command.is_single_datapoint()) {
+    const uint8_t datapoint_id = command.payload()[0];
+    auto *pending = this->find_pending_datapoint_write_(datapoint_id);
+    if ((pending != nullptr) && pending->merge_datapoint_record(command.payload())) {
+      ESP_LOGV(TAG, "Replacing queued value of datapoint %u", datapoint_id);
+      return;
+    }
+  }
+
+  this->send_command_(command);
+}
+
+void Uyat::begin_batch() {
+  ++this->batch_depth_;
+}
+
+void Uyat::commit_batch() {
+  if (this->batch_depth_ == 0u) {
+    ESP_LOGW(TAG, "commit_batch() without begin_batch()");
+    return;
+  }
+
+  if (--this->batch_depth_ > 0u) {
+    return;
+  }
+
+  if (this->batch_command_.has_value()) {
+    const UyatCommand command = *this->batch_command_;
+    this->batch_command_.reset();
+    this->queue_datapoint_frame_(command);
+  }
+}
+
+UyatCommand *Uyat::find_pending_datapoint_write_(const uint8_t datapoint_id) {
+  // the current command is already in flight, only the queued ones can be touched
+  return this->command_queue_.find_last_if(UyatCommandPriority::USER_WRITE,
+                                           [datapoint_id](const UyatCommand &command) {
+    return (command.cmd == UyatCommandType::DATAPOINT_DELIVER) &&
+           command.find_datapoint_record(datapoint_id).has_value();
+  });
 }
 
 void Uyat::register_datapoint_listener(const uint8_t datapoint_id,
@@ -774,24 +1292,107 @@ void Uyat::register_datapoint_listener(const MatchingDatapoint& matching_dp,
                              const OnDatapointCallback &func) {
   auto listener = UyatDatapointListener{
       .configured = matching_dp,
+      .type_mask = matching_dp.get_type_mask(),
       .on_datapoint = func,
   };
-  this->listeners_.push_back(listener);
+  this->listeners_.add(matching_dp.number, listener);
 
-  // Run through existing datapoints
-  for (auto &datapoint : this->cached_datapoints_) {
-    if (datapoint.matches(listener.configured))
+  // Pass the already reported value
+  const auto cached_type = this->datapoint_cache_.get_type(matching_dp.number);
+  if (cached_type.has_value() && (listener.type_mask & MatchingDatapoint::get_type_bit(*cached_type)))
+  {
+    const auto payload = this->datapoint_cache_.get_payload(matching_dp.number);
+    if (payload.has_value())
     {
-      listener.on_datapoint(datapoint);
+      listener.on_datapoint(DatapointView{matching_dp.number, *cached_type, *payload});
 #ifdef UYAT_DIAGNOSTICS_ENABLED
-      remove_from_vector(this->unhandled_datapoints_set_, datapoint.number);
+      this->unhandled_datapoints_set_.reset(matching_dp.number);
 #endif
     }
+    else
+    {
+      ESP_LOGV(TAG, "Datapoint %u value is not retained, the listener will get the next report", matching_dp.number);
+    }
   }
 }
 
 UyatInitState Uyat::get_init_state() { return this->init_state_; }
 
+void Uyat::set_init_state_(const UyatInitState state) {
+  const uint32_t now = millis();
+  if (this->init_state_ == UyatInitState::INIT_DONE) {
+    // initialization starts over, eg. after WIFI_RESET
+    this->init_phase_durations_.fill(0);
+  } else {
+    this->init_phase_durations_[static_cast<std::size_t>(this->init_state_)] += now - this->init_phase_start_;
+  }
+  this->init_phase_start_ = now;
+  this->init_state_ = state;
+
+  if (state == UyatInitState::INIT_DONE) {
+    ESP_LOGI(TAG, "Initialized in %s", this->format_init_timing_().c_str());
+  }
+}
+
+StaticString Uyat::format_init_timing_() const {
+  const auto &phases = this->init_phase_durations_;
+  uint32_t total = 0;
+  for (const auto duration : phases) {
+    total += duration;
+  }
+  return StringHelpers::sprintf("%" PRIu32 " ms (heartbeat %" PRIu32 ", product %" PRIu32 ", conf %" PRIu32
+                                ", wifi %" PRIu32 ", datapoints %" PRIu32 " ms)%s",
+                                total, phases[0], phases[1], phases[2], phases[3], phases[4],
+                                this->handshake_from_cache_ ? ", cached handshake" : "");
+}
+
+void Uyat::set_product_(const StaticString &product) {
+  this->product_ = product;
+#ifdef UYAT_DIAGNOSTICS_ENABLED
+  if (this->product_text_sensor_)
+  {
+    this->product_text_sensor_->publish_state(this->product_.c_str());
+  }
+#endif
+}
+
+void Uyat::load_handshake_cache_() {
+  this->handshake_pref_ = global_preferences->make_preference<CachedHandshake>(fnv1_hash("uyat_handshake"), true);
+  CachedHandshake cached{};
+  if (this->handshake_pref_.load(&cached) && (cached.product_length <= sizeof(cached.product))) {
+    this->cached_handshake_ = cached;
+  } else {
+    ESP_LOGD(TAG, "No cached handshake");
+  }
+}
+
+void Uyat::save_handshake_cache_() {
+  if (!this->cache_handshake_) {
+    return;
+  }
+  CachedHandshake handshake{};
+  if (this->product_.size() > sizeof(handshake.product)) {
+    ESP_LOGW(TAG, "Product info too long to be cached (%zu bytes)", this->product_.size());
+    return;
+  }
+  handshake.product_length = this->product_.size();
+  std::copy(this->product_.begin(), this->product_.end(), handshake.product);
+  handshake.status_pin = this->status_pin_reported_;
+  handshake.reset_pin = this->reset_pin_reported_;
+
+  // only written when it changes, which is practically never
+  if (this->cached_handshake_.has_value() &&
+      (std::memcmp(&*this->cached_handshake_, &handshake, sizeof(handshake)) == 0)) {
+    return;
+  }
+  if (this->handshake_pref_.save(&handshake)) {
+    ESP_LOGD(TAG, "Handshake cached");
+    this->cached_handshake_ = handshake;
+  } else {
+    ESP_LOGW(TAG, "Caching the handshake failed");
+  }
+}
+
 void Uyat::report_wifi_connected_or_retry_(const uint32_t delay_ms)
 {
   if (esphome::network::is_connected())
@@ -821,7 +1422,7 @@ void Uyat::report_cloud_connected_()
   this->send_wifi_status_(static_cast<uint8_t>(this->wifi_status_));
 }
 
-void Uyat::query_product_info_with_retries_()
+void Uyat::query_product_info_with_retries_(const int attempt)
 {
   this->cancel_timeout("wifi_status");
   this->cancel_timeout("product");
@@ -831,20 +1432,28 @@ void Uyat::query_product_info_with_retries_()
   }
 
   this->send_empty_command_(UyatCommandType::PRODUCT_QUERY);
-  this->set_timeout("product", 2000, [this] {
+  if (this->init_mode_ == UyatInitMode::PIPELINED)
+  {
+    // the configuration doesn't depend on the product info, ask for both at once
+    this->send_empty_command_(UyatCommandType::CONF_QUERY);
+  }
+  // the queued query is resent MAX_RETRIES times by itself, start over only when all of them went unanswered
+  const uint32_t retry_delay =
+      this->get_retry_backoff_(this->get_response_timeout_(UyatCommandType::PRODUCT_QUERY) * MAX_RETRIES, attempt);
+  this->set_timeout("product", retry_delay, [this, attempt] {
       ESP_LOGW(TAG, "No response to PRODUCT_QUERY, retrying...");
-      this->query_product_info_with_retries_();
+      this->query_product_info_with_retries_(attempt + 1);
     });
 }
 
-StaticString Uyat::process_get_module_information_(const StaticDeque::DequeView &view)
+StaticString Uyat::process_get_module_information_(const ByteView &view)
 {
   // By default, we return an empty string indicating failure
   bool want_ssid = false;
   bool want_country_code = false;
   bool want_sn = false;
 
-  if (view.size_ == 0)
+  if (view.size() == 0)
   {
     return {};
   }
@@ -857,7 +1466,7 @@ StaticString Uyat::process_get_module_information_(const StaticDeque::DequeView
   }
   else
   {
-    for (size_t i = 0; i < view.size_; ++i)
+    for (size_t i = 0; i < view.size(); ++i)
     {
       switch (view.byte_at(i))
       {
@@ -954,11 +1563,8 @@ void Uyat::update_pairing_mode_sensor_()
 void Uyat::trigger_factory_reset(const FactoryResetType reset_type)
 {
   send_raw_command_(UyatCommand{
-      .cmd = UyatCommandType::EXTENDED_SERVICES,
-      .payload = std::vector<uint8_t>{
-          static_cast<uint8_t>(UyatExtendedServicesCommandType::FACTORY_RESET),
-          reset_type
-          }});
+      UyatCommandType::EXTENDED_SERVICES,
+      {static_cast<uint8_t>(UyatExtendedServicesCommandType::FACTORY_RESET), reset_type}});
 }
 
 
@@ -1,18 +1,29 @@
 #pragma once
 
 #include <cinttypes>
+#include <array>
+#include <bitset>
+#include <memory>
 #include <vector>
-#include <deque>
 #include <variant>
 
+#include "esphome/core/automation.h"
 #include "esphome/core/component.h"
 #include "esphome/core/defines.h"
 #include "esphome/core/helpers.h"
+#include "esphome/core/log.h"
 #include "esphome/components/uart/uart.h"
 #include "esphome/components/sensor/sensor.h"
 #include "esphome/components/text_sensor/text_sensor.h"
 #include "uyat_string.hpp"
-#include "uyat_deque.hpp"
+#include "uyat_ring_buffer.hpp"
+#include "uyat_command.h"
+#include "uyat_rtt_estimator.hpp"
+#include "uyat_listener_table.hpp"
+#include "uyat_datapoint_cache.hpp"
+#include "uyat_warm_start.h"
+#include "uyat_write_tracker.hpp"
+#include "uyat_async.hpp"
 
 #ifdef USE_TIME
 #include "esphome/components/time/real_time_clock.h"
@@ -42,31 +53,10 @@ enum FactoryResetType: uint8_t {
 
 struct UyatDatapointListener {
   MatchingDatapoint configured;
+  uint8_t type_mask;
   OnDatapointCallback on_datapoint;
 };
 
-enum class UyatCommandType : uint8_t {
-  HEARTBEAT = 0x00,
-  PRODUCT_QUERY = 0x01,
-  CONF_QUERY = 0x02,
-  WIFI_STATE = 0x03,
-  WIFI_RESET = 0x04,
-  WIFI_SELECT = 0x05,
-  DATAPOINT_DELIVER = 0x06,
-  DATAPOINT_REPORT_ASYNC = 0x07,
-  DATAPOINT_QUERY = 0x08,
-  WIFI_TEST = 0x0E,
-  LOCAL_TIME_QUERY = 0x1C,
-  DATAPOINT_REPORT_SYNC = 0x22,
-  DATAPOINT_REPORT_ACK = 0x23,
-  WIFI_RSSI = 0x24,
-  DISABLE_HEARTBEATS = 0x25,
-  VACUUM_MAP_UPLOAD = 0x28,
-  GET_NETWORK_STATUS = 0x2B,
-  GET_MAC_ADDRESS = 0x2D,
-  EXTENDED_SERVICES = 0x34,
-};
-
 enum class UyatExtendedServicesCommandType : uint8_t {
   RESET_NOTIFICATION = 0x04,
   FACTORY_RESET = 0x05,
@@ -83,17 +73,28 @@ enum class UyatInitState : uint8_t {
   INIT_DONE,
 };
 
-struct UyatCommand {
-  UyatCommandType cmd;
-  std::vector<uint8_t> payload;
+enum class UyatInitMode : uint8_t {
+  SERIAL,     // one query at a time, each waits for the answer to the previous one
+  PIPELINED,  // independent queries are sent together, the answers are matched by their type
 };
 
+// command types for which the response round-trip time is measured
+static constexpr std::array<UyatCommandType, 5> RTT_TRACKED_COMMANDS{
+  UyatCommandType::HEARTBEAT, UyatCommandType::PRODUCT_QUERY, UyatCommandType::CONF_QUERY,
+  UyatCommandType::DATAPOINT_DELIVER, UyatCommandType::DATAPOINT_QUERY};
+
 template<typename... Ts> class FactoryResetAction;
 
 class Uyat : public Component, public uart::UARTDevice, public DatapointHandler {
 #ifdef UYAT_DIAGNOSTICS_ENABLED
   SUB_TEXT_SENSOR(product)
   SUB_SENSOR(num_garbage_bytes)
+  SUB_SENSOR(num_poll_budget_hits)
+  SUB_SENSOR(num_expired_frames)
+  SUB_SENSOR(num_unconfirmed_writes)
+  SUB_TEXT_SENSOR(command_queue)
+  SUB_SENSOR(num_dropped_commands)
+  SUB_SENSOR(command_queue_high_water)
   SUB_TEXT_SENSOR(unknown_commands)
   SUB_TEXT_SENSOR(unknown_extended_commands)
   SUB_TEXT_SENSOR(unhandled_datapoints)
@@ -104,21 +105,65 @@ class Uyat : public Component, public uart::UARTDevice, public DatapointHandler
   void setup() override;
   void loop() override;
   void dump_config() override;
+  void on_shutdown() override;
   void register_datapoint_listener(const uint8_t datapoint_id, const OnDatapointCallback &func);
   void register_datapoint_listener(const uint8_t datapoint_id, const UyatDatapointType type, const OnDatapointCallback &func);
   void register_datapoint_listener(const MatchingDatapoint& matching_dp, const OnDatapointCallback &func) override;
   void set_datapoint_value(const UyatDatapoint& value, const bool forced = false) override;
+  WriteHandle write_datapoint_value(const UyatDatapoint& value, const OnWriteCompleteCallback& on_complete,
+                                    const uint32_t timeout_ms = 0u, const bool forced = false) override;
+  UyatWriteResult get_write_result(const WriteHandle handle) const override;
+#ifdef UYAT_ASYNC_SUPPORTED
+  // awaitables for UyatTask coroutines, see uyat_async.hpp
+  WriteAwaiter async_write(const UyatDatapoint &value, const uint32_t timeout_ms = 0u) {
+    return WriteAwaiter(*this, value, timeout_ms);
+  }
+  NextReportAwaiter next_report(const uint8_t datapoint_id, const uint32_t timeout_ms = 0u);
+  ValueAwaiter wait_for_value(const UyatDatapoint &value, const uint32_t timeout_ms = 0u);
+  DelayAwaiter async_delay(const uint32_t delay_ms);
+#endif
+  void begin_batch() override;
+  void commit_batch() override;
   void set_status_pin(InternalGPIOPin *status_pin) { this->status_pin_ = status_pin; }
   void send_generic_command(const UyatCommand &command) { send_command_(command); }
+  std::size_t get_command_queue_depth(const UyatCommandPriority priority) const;
   UyatInitState get_init_state();
   void set_report_ap_name(const char* ap_name) { this->report_ap_name_ = ap_name; }
+  void set_max_uart_poll_time(const uint32_t max_poll_time_ms) { this->max_uart_poll_time_ms_ = max_poll_time_ms; }
+  void set_max_uart_poll_bytes(const std::size_t max_poll_bytes) { this->max_uart_poll_bytes_ = max_poll_bytes; }
+  void set_max_frames_per_loop(const std::size_t max_frames) { this->max_frames_per_loop_ = max_frames; }
+  void set_max_commands_per_loop(const std::size_t max_commands) { this->max_commands_per_loop_ = max_commands; }
+  void set_init_mode(const UyatInitMode mode) { this->init_mode_ = mode; }
+  void set_max_writes_in_flight(const std::size_t max_writes) { this->max_writes_in_flight_ = max_writes; }
+  void set_confirm_write_value(const bool confirm_value) { this->confirm_write_value_ = confirm_value; }
+  void set_write_confirm_timeout(const uint32_t timeout_ms) { this->write_confirm_timeout_ms_ = timeout_ms; }
+  void set_command_queue_overflow_policy(const UyatQueueOverflowPolicy policy) { this->command_queue_.set_overflow_policy(policy); }
+  void set_response_timeout_limits(const uint32_t min_ms, const uint32_t max_ms) {
+    this->min_response_timeout_ms_ = min_ms;
+    this->max_response_timeout_ms_ = max_ms;
+  }
+  void set_command_delay_limits(const uint32_t min_ms, const uint32_t max_ms) {
+    this->min_command_delay_ms_ = min_ms;
+    this->max_command_delay_ms_ = max_ms;
+  }
 
 #ifdef USE_TIME
   void set_time_id(time::RealTimeClock *time_id) { this->time_id_ = time_id; }
 #endif
   void add_ignore_mcu_update_on_datapoints(uint8_t ignore_mcu_update_on_datapoints) {
-    this->ignore_mcu_update_on_datapoints_.push_back(ignore_mcu_update_on_datapoints);
+    this->ignore_mcu_update_on_datapoints_.set(ignore_mcu_update_on_datapoints);
   }
+  void add_notify_on_change_only(const uint8_t datapoint_id) { this->notify_on_change_only_.set(datapoint_id); }
+  void set_notify_on_change_only_all() { this->notify_on_change_only_.set(); }
+  void set_notify_refresh_interval(const uint32_t interval_ms) { this->notify_refresh_interval_ms_ = interval_ms; }
+  // the backend is owned by the caller and must outlive the component
+  void set_warm_start_backend(WarmStartBackend *backend) { this->warm_start_backend_ = backend; }
+  void set_warm_start(const WarmStartStorage storage, const uint32_t min_interval_ms) {
+    this->warm_start_storage_ = storage;
+    this->warm_start_min_interval_ms_ = min_interval_ms;
+  }
+  void set_cache_handshake(const bool cache_handshake) { this->cache_handshake_ = cache_handshake; }
+  void add_retained_datapoint(const uint8_t datapoint_id) { this->datapoint_cache_.set_retain_full(datapoint_id); }
   void add_on_initialized_callback(std::function<void()> callback) {
     this->initialized_callback_.add(std::move(callback));
   }
@@ -158,26 +203,65 @@ class Uyat : public Component, public uart::UARTDevice, public DatapointHandler
   }
 
  protected:
-  void handle_input_buffer_();
-  void handle_datapoints_(const StaticDeque::DequeView &buffer);
-  optional<UyatDatapoint> get_datapoint_(uint8_t datapoint_id);
-  // returns number of bytes to remove from the beginning of rx buffer
-  std::size_t validate_message_();
-
-  void handle_command_(uint8_t command, uint8_t version, const StaticDeque::DequeView &view);
-  void send_raw_command_(UyatCommand command);
-  void process_command_queue_();
+  void read_input_();
+  // parses and handles one complete frame, false if there's none
+  bool handle_next_frame_();
+  // drops the frame in progress if the rest of it didn't arrive in time
+  void expire_partial_frame_();
+  // how long the MCU may stay silent in the middle of a frame, depends on the baud rate and the frame length
+  uint32_t get_partial_frame_timeout_() const;
+  void handle_datapoints_(const ByteView &buffer);
+
+  void handle_command_(uint8_t command, uint8_t version, const ByteView &view);
+  void send_raw_command_(const UyatCommand &command);
+  // true if a command was sent
+  bool process_command_queue_();
+  // retries or gives up on the commands whose response didn't come in time
+  void expire_in_flight_commands_(const uint32_t now);
+  // how many commands may wait for their response at once
+  std::size_t get_max_in_flight_() const;
+  // completes the writes waiting for a report of this datapoint
+  void confirm_datapoint_write_(const DatapointView &datapoint);
+  // how long to wait for the response to this command, from its measured round-trip time
+  uint32_t get_response_timeout_(const UyatCommandType command) const;
+  // gap between consecutive frames, from the fastest measured round-trip time
+  uint32_t get_command_delay_() const;
+  // exponential backoff: base_ms doubled for every attempt, plus up to 50% of random jitter
+  uint32_t get_retry_backoff_(const uint32_t base_ms, const int attempt) const;
   void send_command_(const UyatCommand &command);
   void send_empty_command_(UyatCommandType command);
-  void set_datapoint_value_(const UyatDatapoint& dp, const bool force = false);
-  void send_datapoint_command_(uint8_t datapoint_id, UyatDatapointType datapoint_type, std::vector<uint8_t> data);
+  // what set_datapoint_value_() did with the value
+  enum class SetValueOutcome : uint8_t {
+    SENT,       // queued, batched or already waiting in the queue
+    UNCHANGED,  // nothing had to be sent, the mcu already reported this value
+    NOT_SENT,   // the value doesn't fit in a frame
+  };
+  SetValueOutcome set_datapoint_value_(const UyatDatapoint& dp, const bool forced);
+  // false if the value doesn't fit in a frame
+  bool send_datapoint_command_(uint8_t datapoint_id, UyatDatapointType datapoint_type, const std::vector<uint8_t> &data);
+  // newest queued DATAPOINT_DELIVER writing this datapoint (alone or with others) which is not in
+  // flight yet, nullptr if there's none
+  UyatCommand *find_pending_datapoint_write_(const uint8_t datapoint_id);
+  // queues a DATAPOINT_DELIVER frame, a single datapoint is written into its newest pending write
+  void queue_datapoint_frame_(const UyatCommand &command);
   void set_status_pin_();
+  void set_init_state_(const UyatInitState state);
+  // how long each phase of the last initialization took
+  StaticString format_init_timing_() const;
+  void set_product_(const StaticString &product);
+  // what follows CONF_QUERY: status pin or WIFI_STATE reports, then DATAPOINT_QUERY
+  void configure_network_();
+  void load_handshake_cache_();
+  void save_handshake_cache_();
+  // passes the values saved before the reboot to the listeners, until the MCU reports the real ones
+  void restore_warm_start_();
+  void save_warm_start_();
   void send_wifi_status_(const uint8_t status);
   uint8_t get_wifi_rssi_();
   void report_wifi_connected_or_retry_(const uint32_t delay_ms);
   void report_cloud_connected_();
-  void query_product_info_with_retries_();
-  StaticString process_get_module_information_(const StaticDeque::DequeView &view);
+  void query_product_info_with_retries_(const int attempt = 0);
+  StaticString process_get_module_information_(const ByteView &view);
   void schedule_heartbeat_(const bool initial);
   void stop_heartbeats_();
 
@@ -192,31 +276,79 @@ class Uyat : public Component, public uart::UARTDevice, public DatapointHandler
   bool time_sync_callback_registered_{false};
 #endif
   UyatInitState init_state_ = UyatInitState::INIT_HEARTBEAT;
+  UyatInitMode init_mode_{UyatInitMode::SERIAL};
+  std::size_t max_writes_in_flight_{1};
+  // a write is only confirmed by a report of the same value, not just of the same datapoint
+  bool confirm_write_value_{false};
+  // writes made with write_datapoint_value(), waiting for the report of the written value
+  WriteTracker write_tracker_;
+  uint32_t write_confirm_timeout_ms_{5000};
+#ifdef UYAT_ASYNC_SUPPORTED
+  // coroutines waiting for a report or for their delay to pass
+  AsyncWaiters async_waiters_;
+#endif
+  uint32_t init_phase_start_ = 0;
+  std::array<uint32_t, static_cast<std::size_t>(UyatInitState::INIT_DONE)> init_phase_durations_{};
   bool init_failed_{false};
   bool heartbeats_enabled_{true};
-  int init_retries_{0};
   uint8_t protocol_version_ = -1;
   InternalGPIOPin *status_pin_{nullptr};
   int status_pin_reported_ = -1;
   int reset_pin_reported_ = -1;
   uint32_t last_command_timestamp_ = 0;
   uint32_t last_rx_char_timestamp_ = 0;
+  uint32_t min_response_timeout_ms_ = 50;
+  uint32_t max_response_timeout_ms_ = 300;
+  uint32_t min_command_delay_ms_ = 2;
+  uint32_t max_command_delay_ms_ = 10;
+  std::array<RttEstimator, RTT_TRACKED_COMMANDS.size()> rtt_estimators_{};
+  uint32_t max_uart_poll_time_ms_ = 10;
+  std::size_t max_uart_poll_bytes_ = 256;
+  std::size_t max_frames_per_loop_ = 8;
+  std::size_t max_commands_per_loop_ = 2;
   StaticString product_ = "";
-  std::vector<UyatDatapointListener> listeners_;
-  std::vector<UyatDatapoint> cached_datapoints_;
-  StaticDeque rx_message_;
-  std::vector<uint8_t> ignore_mcu_update_on_datapoints_{};
-  std::vector<UyatCommand> command_queue_;
-  optional<UyatCommandType> expected_response_{};
+  DatapointListenerTable<UyatDatapointListener> listeners_;
+  DatapointCache datapoint_cache_;
+  RxRingBuffer rx_message_;
+  FrameParser frame_parser_;
+  std::bitset<256> ignore_mcu_update_on_datapoints_{};
+  // unchanged reports of these datapoints are not passed to the listeners...
+  std::bitset<256> notify_on_change_only_{};
+  // ...unless the datapoint wasn't passed on since the last refresh
+  std::bitset<256> notified_since_refresh_{};
+  uint32_t notify_refresh_interval_ms_{0};
+  WarmStartBackend *warm_start_backend_{nullptr};
+  optional<WarmStartStorage> warm_start_storage_{};
+  std::unique_ptr<PreferencesWarmStartBackend> preferences_warm_start_backend_{};
+  uint32_t warm_start_min_interval_ms_{300000};
+  uint32_t warm_start_sequence_{0};
+  bool warm_start_dirty_{false};
+  // cached values restored from the warm start snapshot, not reported by the MCU yet
+  std::bitset<256> provisional_datapoints_{};
+  bool cache_handshake_{false};
+  ESPPreferenceObject handshake_pref_;
+  optional<CachedHandshake> cached_handshake_{};
+  // the last initialization used the cached handshake...
+  bool handshake_from_cache_{false};
+  // ...which PRODUCT_QUERY and CONF_QUERY haven't confirmed yet
+  bool handshake_unconfirmed_{false};
+  UyatCommandQueue command_queue_;
+  // sent and waiting for the response, or to be sent again
+  UyatInFlightCommands in_flight_;
+  optional<UyatCommand> batch_command_{};
+  uint8_t batch_depth_{0};
   UyatNetworkStatus wifi_status_{UyatNetworkStatus::WIFI_CONFIGURED};
   optional<bool> requested_wifi_config_is_ap_{};
   CallbackManager<void()> initialized_callback_{};
 
 #ifdef UYAT_DIAGNOSTICS_ENABLED
   uint64_t num_garbage_bytes_{0};
+  uint32_t num_poll_budget_hits_{0};
+  uint32_t num_expired_frames_{0};
+  uint32_t num_unconfirmed_writes_{0};
   std::vector<uint8_t> unknown_commands_set_;
   std::vector<uint8_t> unknown_extended_commands_set_;
-  std::vector<uint8_t> unhandled_datapoints_set_;
+  std::bitset<256> unhandled_datapoints_set_;
 #endif
 };
 
@@ -233,4 +365,71 @@ template<typename... Ts> class FactoryResetAction : public Action<Ts...> {
   Uyat *uyat_;
 };
 
+// Sets the value and continues only when the mcu reports it back. If that doesn't happen, the rest
+// of the automation is not run.
+template<typename... Ts> class WriteDatapointAction : public Action<Ts...> {
+ public:
+  explicit WriteDatapointAction(Uyat *uyat) : uyat_(uyat) {}
+  TEMPLATABLE_VALUE(uint32_t, value);
+  void set_datapoint_id(const uint8_t datapoint_id) { this->datapoint_id_ = datapoint_id; }
+  void set_datapoint_type(const UyatDatapointType datapoint_type) { this->datapoint_type_ = datapoint_type; }
+  void set_timeout(const uint32_t timeout_ms) { this->timeout_ms_ = timeout_ms; }
+
+  void play_complex(const Ts &...x) override {
+    if (this->handle_.is_valid()) {
+      // the previous run never finishes, this one replaces it
+      this->num_running_--;
+    }
+    this->num_running_++;
+    this->args_ = std::make_tuple(x...);
+    this->handle_ = this->uyat_->write_datapoint_value(
+        this->make_datapoint_(this->value_.value(x...)),
+        [this](const WriteHandle handle, const UyatWriteResult result, const uint32_t latency_ms) {
+          this->on_complete_(handle, result, latency_ms);
+        },
+        this->timeout_ms_);
+  }
+
+  void play(const Ts &...x) override { /* handled in play_complex */ }
+
+  void stop() override { this->handle_ = WriteHandle{}; }
+
+ protected:
+  static constexpr const char *TAG = "uyat.write_datapoint";
+
+  UyatDatapoint make_datapoint_(const uint32_t value) const {
+    switch (this->datapoint_type_) {
+    case UyatDatapointType::BOOLEAN:
+      return UyatDatapoint{this->datapoint_id_, BoolDatapointValue{value != 0u}};
+    case UyatDatapointType::ENUM:
+      return UyatDatapoint{this->datapoint_id_, EnumDatapointValue{static_cast<uint8_t>(value)}};
+    case UyatDatapointType::BITMAP:
+      return UyatDatapoint{this->datapoint_id_, BitmapDatapointValue{value}};
+    default:
+      return UyatDatapoint{this->datapoint_id_, UIntDatapointValue{value}};
+    }
+  }
+
+  void on_complete_(const WriteHandle handle, const UyatWriteResult result, const uint32_t latency_ms) {
+    if (!(handle == this->handle_) || (this->num_running_ == 0)) {
+      return;  // stopped or replaced meanwhile
+    }
+    this->handle_ = WriteHandle{};
+    if (result == UyatWriteResult::CONFIRMED) {
+      ESP_LOGV(TAG, "Datapoint %u write confirmed after %" PRIu32 " ms", this->datapoint_id_, latency_ms);
+      this->play_next_tuple_(this->args_);
+    } else {
+      ESP_LOGW(TAG, "Datapoint %u write failed: %s", this->datapoint_id_, write_result_to_string(result));
+      this->stop_complex();
+    }
+  }
+
+  Uyat *uyat_;
+  uint8_t datapoint_id_{0};
+  UyatDatapointType datapoint_type_{UyatDatapointType::INTEGER};
+  uint32_t timeout_ms_{0};
+  WriteHandle handle_{};
+  std::tuple<Ts...> args_{};
+};
+
 }  // namespace esphome::uyat
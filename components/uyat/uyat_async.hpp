@@ -0,0 +1,416 @@
+#pragma once
+
+// Coroutines need C++20 with their support enabled in the compiler, without it this header is empty
+// and the async API of Uyat is not available.
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#define UYAT_ASYNC_SUPPORTED
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <optional>
+
+#include "esphome/core/log.h"
+
+#include "uyat_datapoint_types.h"
+#include "uyat_write_tracker.hpp"
+
+#ifndef UYAT_COROUTINE_FRAMES
+#define UYAT_COROUTINE_FRAMES 4
+#endif
+
+#ifndef UYAT_COROUTINE_FRAME_SIZE
+#define UYAT_COROUTINE_FRAME_SIZE 512
+#endif
+
+namespace esphome::uyat
+{
+
+static constexpr const std::size_t COROUTINE_FRAMES = UYAT_COROUTINE_FRAMES;
+static constexpr const std::size_t COROUTINE_FRAME_SIZE = UYAT_COROUTINE_FRAME_SIZE;
+static_assert((COROUTINE_FRAMES > 0u) && (COROUTINE_FRAMES <= 32u), "UYAT_COROUTINE_FRAMES must be 1..32");
+
+// Fixed storage for the frames of UyatTask coroutines, they never go to the heap. The storage is
+// only linked in if a coroutine is actually written.
+class CoroutineFramePool
+{
+public:
+   static constexpr const char* TAG = "uyat.async";
+
+   static CoroutineFramePool& get()
+   {
+      static CoroutineFramePool instance;
+      return instance;
+   }
+
+   // nullptr if the frame is too big or all frames are taken
+   void* allocate(const std::size_t size)
+   {
+      if (size > COROUTINE_FRAME_SIZE)
+      {
+         ESP_LOGE(TAG, "Coroutine frame of %zu bytes is bigger than %zu, raise coroutine_frame_size", size,
+                  COROUTINE_FRAME_SIZE);
+         return nullptr;
+      }
+      for (std::size_t i = 0u; i < COROUTINE_FRAMES; i++)
+      {
+         if ((used_ & (1u << i)) == 0u)
+         {
+            used_ |= (1u << i);
+            return frames_[i].bytes;
+         }
+      }
+      ESP_LOGW(TAG, "All %zu coroutine frames are in use", COROUTINE_FRAMES);
+      return nullptr;
+   }
+
+   void free(void* frame)
+   {
+      const auto idx = reinterpret_cast<Frame*>(frame) - frames_.data();
+      used_ &= ~(1u << idx);
+   }
+
+   std::size_t num_used() const
+   {
+      return std::popcount(used_);
+   }
+
+private:
+   struct Frame
+   {
+      alignas(std::max_align_t) std::byte bytes[COROUTINE_FRAME_SIZE];
+   };
+
+   std::array<Frame, COROUTINE_FRAMES> frames_{};
+   uint32_t used_{0u};
+};
+
+// Return type of a coroutine scripting the mcu, eg.
+//
+//   UyatTask heat(Uyat* uyat)
+//   {
+//      co_await uyat->async_write(UyatDatapoint{5, BoolDatapointValue{true}});
+//      ...
+//   }
+//
+// The coroutine starts right away and runs until its first co_await, then it's resumed from the main
+// loop when the awaited event happens. It can't be cancelled, so everything it refers to must live
+// as long as it runs - pass values as parameters, they are copied into the frame.
+class UyatTask
+{
+public:
+   struct promise_type
+   {
+      UyatTask get_return_object()
+      {
+         return UyatTask(true);
+      }
+
+      static UyatTask get_return_object_on_allocation_failure()
+      {
+         return UyatTask(false);
+      }
+
+      static void* operator new(const std::size_t size) noexcept
+      {
+         return CoroutineFramePool::get().allocate(size);
+      }
+
+      static void operator delete(void* frame)
+      {
+         CoroutineFramePool::get().free(frame);
+      }
+
+      std::suspend_never initial_suspend() noexcept
+      {
+         return {};
+      }
+
+      std::suspend_never final_suspend() noexcept
+      {
+         return {};
+      }
+
+      void return_void()
+      {}
+
+      void unhandled_exception()
+      {
+         std::abort();
+      }
+   };
+
+   // false if the coroutine didn't start, because there was no free frame or its frame is bigger
+   // than UYAT_COROUTINE_FRAME_SIZE
+   explicit operator bool() const
+   {
+      return started_;
+   }
+
+private:
+   explicit UyatTask(const bool started):
+   started_(started)
+   {}
+
+   bool started_;
+};
+
+class AsyncWaiters;
+
+// Common part of the awaitables waiting for a report, or just for the time to pass.
+class ReportWait
+{
+public:
+   std::coroutine_handle<> handle{};
+   uint32_t deadline{0u};
+   uint32_t armed_at{0u};
+   bool has_deadline{false};
+   bool timed_out{false};
+
+   // true if the report resumes the coroutine
+   virtual bool accept(const DatapointView&)
+   {
+      return false;
+   }
+
+protected:
+   ReportWait(AsyncWaiters& waiters, const uint32_t timeout_ms, const uint32_t now):
+   deadline(now + timeout_ms),
+   has_deadline(timeout_ms > 0u),
+   waiters_(waiters)
+   {}
+
+   ~ReportWait() = default;
+
+   // registers the wait, if there is no room the coroutine continues as if it timed out
+   bool suspend_(std::coroutine_handle<> handle);
+
+   AsyncWaiters& waiters_;
+};
+
+// Suspended coroutines waiting for a report or a deadline. Each coroutine waits for one thing at a
+// time, so there is a slot for every frame.
+class AsyncWaiters
+{
+public:
+   // false if there's no free slot
+   bool add(ReportWait& wait)
+   {
+      for (auto& slot : waits_)
+      {
+         if (slot == nullptr)
+         {
+            wait.armed_at = reports_;
+            slot = &wait;
+            return true;
+         }
+      }
+      return false;
+   }
+
+   // Call before anything else handles the report: coroutines resumed meanwhile start waiting for
+   // the next one, not this one.
+   void begin_report()
+   {
+      ++reports_;
+   }
+
+   void on_report(const DatapointView& datapoint)
+   {
+      for (auto& slot : waits_)
+      {
+         ReportWait* wait = slot;
+         if ((wait == nullptr) || (wait->armed_at == reports_) || !wait->accept(datapoint))
+         {
+            continue;
+         }
+         slot = nullptr;
+         // the coroutine may finish here, the wait is gone after this
+         wait->handle.resume();
+      }
+   }
+
+   void expire(const uint32_t now)
+   {
+      for (auto& slot : waits_)
+      {
+         ReportWait* wait = slot;
+         if ((wait == nullptr) || !wait->has_deadline || (static_cast<int32_t>(now - wait->deadline) < 0))
+         {
+            continue;
+         }
+         slot = nullptr;
+         wait->timed_out = true;
+         wait->handle.resume();
+      }
+   }
+
+   std::size_t size() const
+   {
+      return std::count_if(waits_.begin(), waits_.end(), [](const ReportWait* wait) { return wait != nullptr; });
+   }
+
+private:
+   std::array<ReportWait*, COROUTINE_FRAMES> waits_{};
+   uint32_t reports_{0u};
+};
+
+inline bool ReportWait::suspend_(std::coroutine_handle<> handle)
+{
+   this->handle = handle;
+   this->timed_out = !waiters_.add(*this);
+   return !this->timed_out;
+}
+
+// co_await uyat->next_report(6, 1000) - the next value the mcu reports for the datapoint, nothing if
+// it doesn't report it in time. A timeout of 0 waits forever.
+class NextReportAwaiter : private ReportWait
+{
+public:
+   NextReportAwaiter(AsyncWaiters& waiters, const uint8_t datapoint_id, const uint32_t timeout_ms, const uint32_t now):
+   ReportWait(waiters, timeout_ms, now),
+   datapoint_id_(datapoint_id)
+   {}
+
+   bool await_ready() const
+   {
+      return false;
+   }
+
+   bool await_suspend(std::coroutine_handle<> handle)
+   {
+      return suspend_(handle);
+   }
+
+   std::optional<UyatDatapoint> await_resume()
+   {
+      return std::move(reported_);
+   }
+
+   bool accept(const DatapointView& datapoint) override
+   {
+      if (datapoint.number != datapoint_id_)
+      {
+         return false;
+      }
+      reported_ = datapoint.to_datapoint();
+      return true;
+   }
+
+private:
+   uint8_t datapoint_id_;
+   std::optional<UyatDatapoint> reported_{};
+};
+
+// co_await uyat->wait_for_value(UyatDatapoint{6, EnumDatapointValue{2}}, 5000) - true once the
+// datapoint has the value, right away if it already has it; false if it doesn't get it in time.
+// A timeout of 0 waits forever.
+class ValueAwaiter : private ReportWait
+{
+public:
+   ValueAwaiter(AsyncWaiters& waiters, const UyatDatapoint& expected, const bool already_set, const uint32_t timeout_ms,
+                const uint32_t now):
+   ReportWait(waiters, timeout_ms, now),
+   datapoint_id_(expected.number),
+   type_(expected.get_type()),
+   already_set_(already_set),
+   value_(expected.value_to_payload())
+   {}
+
+   bool await_ready() const
+   {
+      return already_set_;
+   }
+
+   bool await_suspend(std::coroutine_handle<> handle)
+   {
+      return suspend_(handle);
+   }
+
+   bool await_resume() const
+   {
+      return already_set_ || !this->timed_out;
+   }
+
+   bool accept(const DatapointView& datapoint) override
+   {
+      return (datapoint.number == datapoint_id_) && (datapoint.type == type_) &&
+             same_datapoint_value(type_, value_.span(), datapoint.payload);
+   }
+
+private:
+   uint8_t datapoint_id_;
+   UyatDatapointType type_;
+   bool already_set_;
+   DatapointBytes value_;
+};
+
+// co_await uyat->async_delay(500)
+class DelayAwaiter : private ReportWait
+{
+public:
+   DelayAwaiter(AsyncWaiters& waiters, const uint32_t delay_ms, const uint32_t now):
+   ReportWait(waiters, delay_ms, now)
+   {}
+
+   bool await_ready() const
+   {
+      return !this->has_deadline;
+   }
+
+   bool await_suspend(std::coroutine_handle<> handle)
+   {
+      return suspend_(handle);
+   }
+
+   void await_resume() const
+   {}
+};
+
+// co_await uyat->async_write(UyatDatapoint{5, BoolDatapointValue{true}}) - the outcome of the write,
+// see write_datapoint_value(). A timeout of 0 uses the configured one.
+class WriteAwaiter
+{
+public:
+   WriteAwaiter(DatapointHandler& handler, const UyatDatapoint& datapoint, const uint32_t timeout_ms):
+   handler_(handler),
+   datapoint_(datapoint),
+   timeout_ms_(timeout_ms)
+   {}
+
+   bool await_ready() const
+   {
+      return false;
+   }
+
+   void await_suspend(std::coroutine_handle<> handle)
+   {
+      handle_ = handle;
+      // the result never comes before write_datapoint_value() returns
+      handler_.write_datapoint_value(datapoint_, [this](const WriteHandle, const UyatWriteResult result, const uint32_t)
+      {
+         result_ = result;
+         handle_.resume();
+      }, timeout_ms_);
+   }
+
+   UyatWriteResult await_resume() const
+   {
+      return result_;
+   }
+
+private:
+   DatapointHandler& handler_;
+   UyatDatapoint datapoint_;
+   uint32_t timeout_ms_;
+   std::coroutine_handle<> handle_{};
+   UyatWriteResult result_{UyatWriteResult::PENDING};
+};
+
+}
+
+#endif
@@ -0,0 +1,605 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cinttypes>
+#include <initializer_list>
+#include <optional>
+#include <span>
+
+#include "uyat_frame_parser.hpp"
+
+namespace esphome::uyat
+{
+
+enum class UyatCommandType : uint8_t {
+  HEARTBEAT = 0x00,
+  PRODUCT_QUERY = 0x01,
+  CONF_QUERY = 0x02,
+  WIFI_STATE = 0x03,
+  WIFI_RESET = 0x04,
+  WIFI_SELECT = 0x05,
+  DATAPOINT_DELIVER = 0x06,
+  DATAPOINT_REPORT_ASYNC = 0x07,
+  DATAPOINT_QUERY = 0x08,
+  WIFI_TEST = 0x0E,
+  LOCAL_TIME_QUERY = 0x1C,
+  DATAPOINT_REPORT_SYNC = 0x22,
+  DATAPOINT_REPORT_ACK = 0x23,
+  WIFI_RSSI = 0x24,
+  DISABLE_HEARTBEATS = 0x25,
+  VACUUM_MAP_UPLOAD = 0x28,
+  GET_NETWORK_STATUS = 0x2B,
+  GET_MAC_ADDRESS = 0x2D,
+  EXTENDED_SERVICES = 0x34,
+};
+
+#ifndef UYAT_MAX_COMMAND_PAYLOAD_SIZE
+#define UYAT_MAX_COMMAND_PAYLOAD_SIZE 256
+#endif
+
+// every queued or in flight command keeps a frame of this size
+static constexpr const std::size_t MAX_COMMAND_PAYLOAD_SIZE = UYAT_MAX_COMMAND_PAYLOAD_SIZE;
+static_assert((MAX_COMMAND_PAYLOAD_SIZE >= 32u) && (MAX_COMMAND_PAYLOAD_SIZE <= 4096u),
+              "UYAT_MAX_COMMAND_PAYLOAD_SIZE must be 32..4096");
+
+// most datapoints written by a single DATAPOINT_DELIVER, batches and coalesced writes with more
+// datapoints are split into more commands
+static constexpr const std::size_t MAX_DATAPOINTS_PER_COMMAND = 8u;
+
+// ids of the datapoints written by a command
+struct DatapointIds {
+  bool empty() const { return this->count == 0u; }
+  std::size_t size() const { return this->count; }
+  bool contains(const uint8_t id) const {
+    return std::find(this->ids.begin(), this->ids.begin() + this->count, id) != (this->ids.begin() + this->count);
+  }
+  std::span<const uint8_t> span() const { return {this->ids.data(), this->count}; }
+
+  // false if there's no room for it
+  bool add(const uint8_t id) {
+    if (this->contains(id)) {
+      return true;
+    }
+    if (this->count >= MAX_DATAPOINTS_PER_COMMAND) {
+      return false;
+    }
+    this->ids[this->count++] = id;
+    return true;
+  }
+
+  void remove(const uint8_t id) {
+    const auto end = this->ids.begin() + this->count;
+    const auto found = std::find(this->ids.begin(), end, id);
+    if (found != end) {
+      *found = this->ids[--this->count];
+    }
+  }
+
+  std::array<uint8_t, MAX_DATAPOINTS_PER_COMMAND> ids{};
+  uint8_t count{0u};
+};
+
+// Command kept directly in its wire format: 55 AA version command length payload checksum.
+// The length and checksum are updated as the payload is appended, so the frame can be
+// sent as it is with a single write. Payloads that don't fit are rejected by append().
+struct UyatCommand {
+  static constexpr std::size_t HEADER_SIZE = FrameParser::HEADER_SIZE;
+  static constexpr std::size_t MAX_FRAME_SIZE = HEADER_SIZE + MAX_COMMAND_PAYLOAD_SIZE + FrameParser::CHECKSUM_SIZE;
+
+  constexpr explicit UyatCommand(const UyatCommandType command):
+  cmd(command),
+  sum_(FrameParser::HEADER_BYTE_1 + FrameParser::HEADER_BYTE_2 + static_cast<uint8_t>(command))
+  {
+    this->frame_[0] = FrameParser::HEADER_BYTE_1;
+    this->frame_[1] = FrameParser::HEADER_BYTE_2;
+    this->frame_[2] = 0x00;  // version
+    this->frame_[3] = static_cast<uint8_t>(command);
+    this->finish_();
+  }
+
+  constexpr UyatCommand(const UyatCommandType command, std::initializer_list<uint8_t> payload):
+  UyatCommand(command)
+  {
+    for (const auto value : payload) {
+      this->append(value);
+    }
+  }
+
+  UyatCommand(const UyatCommandType command, const uint8_t *data, const std::size_t len):
+  UyatCommand(command)
+  {
+    this->append(data, len);
+  }
+
+  constexpr bool append(const uint8_t value) {
+    if (this->payload_size_ >= MAX_COMMAND_PAYLOAD_SIZE) {
+      return false;
+    }
+    this->frame_[HEADER_SIZE + this->payload_size_] = value;
+    this->sum_ += value;
+    ++this->payload_size_;
+    this->finish_();
+    return true;
+  }
+
+  bool append(const uint8_t *data, const std::size_t len) {
+    if (len > (MAX_COMMAND_PAYLOAD_SIZE - this->payload_size_)) {
+      return false;
+    }
+    for (std::size_t i = 0; i < len; ++i) {
+      this->frame_[HEADER_SIZE + this->payload_size_ + i] = data[i];
+      this->sum_ += data[i];
+    }
+    this->payload_size_ += len;
+    this->finish_();
+    return true;
+  }
+
+  constexpr std::size_t payload_size() const { return this->payload_size_; }
+  std::span<const uint8_t> payload() const { return {&this->frame_[HEADER_SIZE], this->payload_size_}; }
+  // the complete frame, ready to be written out
+  std::span<const uint8_t> frame() const { return {this->frame_.data(), HEADER_SIZE + this->payload_size_ + FrameParser::CHECKSUM_SIZE}; }
+
+  // the record (id, type, length, value) of the datapoint in a DATAPOINT_DELIVER payload
+  std::optional<std::span<const uint8_t>> find_datapoint_record(const uint8_t datapoint_id) const {
+    const auto payload = this->payload();
+    std::size_t offset = 0u;
+    while ((offset + 4u) <= payload.size()) {
+      const std::size_t record_size = 4u + ((std::size_t(payload[offset + 2u]) << 8) | payload[offset + 3u]);
+      if ((offset + record_size) > payload.size()) {
+        break;
+      }
+      if (payload[offset] == datapoint_id) {
+        return payload.subspan(offset, record_size);
+      }
+      offset += record_size;
+    }
+    return std::nullopt;
+  }
+
+  // ids of all datapoints in a DATAPOINT_DELIVER payload
+  DatapointIds datapoint_ids() const {
+    DatapointIds ids{};
+    const auto payload = this->payload();
+    std::size_t offset = 0u;
+    while ((offset + 4u) <= payload.size()) {
+      ids.add(payload[offset]);
+      offset += 4u + ((std::size_t(payload[offset + 2u]) << 8) | payload[offset + 3u]);
+    }
+    return ids;
+  }
+
+  // true if the payload is exactly one datapoint record
+  bool is_single_datapoint() const {
+    const auto payload = this->payload();
+    if (payload.empty()) {
+      return false;
+    }
+    const auto record = this->find_datapoint_record(payload[0]);
+    return record.has_value() && (record->size() == payload.size());
+  }
+
+  // Adds the datapoint record to a DATAPOINT_DELIVER payload, an older record of the same datapoint
+  // is removed. Returns false (and leaves the command as it was) if the result doesn't fit, or if
+  // it would write more than MAX_DATAPOINTS_PER_COMMAND datapoints.
+  bool merge_datapoint_record(const std::span<const uint8_t> record) {
+    if (record.size() < 4u) {
+      return false;
+    }
+
+    const auto payload = this->payload();
+    const auto previous = this->find_datapoint_record(record[0]);
+    const std::size_t previous_size = previous.has_value() ? previous->size() : 0u;
+    if ((payload.size() - previous_size + record.size()) > MAX_COMMAND_PAYLOAD_SIZE) {
+      return false;
+    }
+    if (!previous.has_value() && (this->datapoint_ids().size() >= MAX_DATAPOINTS_PER_COMMAND)) {
+      return false;
+    }
+
+    if (previous.has_value()) {
+      UyatCommand rebuilt{this->cmd};
+      const std::size_t previous_offset = previous->data() - payload.data();
+      rebuilt.append(payload.data(), previous_offset);
+      rebuilt.append(previous->data() + previous_size, payload.size() - previous_offset - previous_size);
+      *this = rebuilt;
+    }
+    return this->append(record.data(), record.size());
+  }
+
+  UyatCommandType cmd;
+
+ private:
+  constexpr void finish_() {
+    const uint8_t len_hi = static_cast<uint8_t>(this->payload_size_ >> 8);
+    const uint8_t len_lo = static_cast<uint8_t>(this->payload_size_ & 0xFF);
+    this->frame_[4] = len_hi;
+    this->frame_[5] = len_lo;
+    this->frame_[HEADER_SIZE + this->payload_size_] = static_cast<uint8_t>(this->sum_ + len_hi + len_lo);
+  }
+
+  std::array<uint8_t, MAX_FRAME_SIZE> frame_{};
+  uint16_t payload_size_{0};
+  uint8_t sum_;  // checksum of everything but the length bytes
+};
+
+// Classes of commands, in the order they are sent when more of them are waiting.
+enum class UyatCommandPriority : uint8_t {
+  PROTOCOL_REPLY = 0,  // answers and acks the mcu is waiting for
+  HEARTBEAT,
+  USER_WRITE,          // datapoint values
+  BULK_QUERY,          // product, configuration and datapoint queries
+};
+
+static constexpr std::size_t NUM_COMMAND_PRIORITIES = 4u;
+
+#ifndef UYAT_COMMAND_QUEUE_SIZE
+#define UYAT_COMMAND_QUEUE_SIZE 16
+#endif
+
+static constexpr const std::size_t COMMAND_QUEUE_SIZE = UYAT_COMMAND_QUEUE_SIZE;
+static_assert((COMMAND_QUEUE_SIZE > 0u) && (COMMAND_QUEUE_SIZE <= 255u), "UYAT_COMMAND_QUEUE_SIZE must be 1..255");
+
+// What to do with a new datapoint write when the queue is full. Only datapoint writes are ever
+// removed to make room: the other commands (eg. the init queries) are not sent again when lost. A new
+// command of another kind always takes the place of the oldest write, it's only dropped if there is
+// no write in the queue.
+enum class UyatQueueOverflowPolicy : uint8_t {
+  DROP_OLDEST,  // make room by removing the oldest queued datapoint write
+  DROP_NEWEST,  // don't queue the new write
+  COALESCE,     // merge the new write into the newest queued one, otherwise as DROP_OLDEST
+};
+
+// TX queue with a FIFO per priority class. The highest priority class with a waiting command goes
+// first, but a class which was passed over MAX_SKIPS times in a row gets its turn, so nothing starves.
+// The commands are kept in a fixed pool of COMMAND_QUEUE_SIZE slots, each class only keeps a ring of
+// slot indices, so pushing and popping are O(1) and nothing is allocated.
+class UyatCommandQueue {
+ public:
+  static constexpr uint8_t MAX_SKIPS = 4u;
+
+  enum class PushResult : uint8_t {
+    QUEUED,
+    COALESCED,       // merged into an already queued command
+    DROPPED_OLDEST,  // queued, an older command was removed to make room
+    DROPPED_NEWEST,  // not queued
+  };
+
+  static constexpr UyatCommandPriority priority_of(const UyatCommandType command) {
+    switch (command) {
+    case UyatCommandType::HEARTBEAT:
+      return UyatCommandPriority::HEARTBEAT;
+    case UyatCommandType::DATAPOINT_DELIVER:
+      return UyatCommandPriority::USER_WRITE;
+    case UyatCommandType::PRODUCT_QUERY:
+    case UyatCommandType::CONF_QUERY:
+    case UyatCommandType::DATAPOINT_QUERY:
+      return UyatCommandPriority::BULK_QUERY;
+    default:
+      return UyatCommandPriority::PROTOCOL_REPLY;
+    }
+  }
+
+  static constexpr const char *priority_name(const UyatCommandPriority priority) {
+    switch (priority) {
+    case UyatCommandPriority::PROTOCOL_REPLY:
+      return "reply";
+    case UyatCommandPriority::HEARTBEAT:
+      return "heartbeat";
+    case UyatCommandPriority::USER_WRITE:
+      return "write";
+    case UyatCommandPriority::BULK_QUERY:
+      return "query";
+    default:
+      return "unknown";
+    }
+  }
+
+  UyatCommandQueue() {
+    for (std::size_t i = 0; i < COMMAND_QUEUE_SIZE; ++i) {
+      this->free_slots_[i] = static_cast<uint8_t>(i);
+    }
+    this->num_free_ = COMMAND_QUEUE_SIZE;
+  }
+
+  void set_overflow_policy(const UyatQueueOverflowPolicy policy) { this->overflow_policy_ = policy; }
+  UyatQueueOverflowPolicy get_overflow_policy() const { return this->overflow_policy_; }
+
+  PushResult push(const UyatCommand &command) { return this->push(command, priority_of(command.cmd)); }
+
+  PushResult push(const UyatCommand &command, const UyatCommandPriority priority) {
+    PushResult result = PushResult::QUEUED;
+    if (this->num_free_ == 0u) {
+      const bool write = (priority == UyatCommandPriority::USER_WRITE);
+      if (write && (this->overflow_policy_ == UyatQueueOverflowPolicy::COALESCE) && this->coalesce_(command, priority)) {
+        return PushResult::COALESCED;
+      }
+      if ((write && (this->overflow_policy_ == UyatQueueOverflowPolicy::DROP_NEWEST)) || !this->drop_oldest_write_()) {
+        ++this->num_dropped_;
+        return PushResult::DROPPED_NEWEST;
+      }
+      result = PushResult::DROPPED_OLDEST;
+    }
+
+    const uint8_t slot = this->free_slots_[--this->num_free_];
+    this->slots_[slot].emplace(command);
+    this->rings_[static_cast<std::size_t>(priority)].push_back(slot);
+
+    const std::size_t used = COMMAND_QUEUE_SIZE - this->num_free_;
+    if (used > this->high_water_) {
+      this->high_water_ = used;
+    }
+    return result;
+  }
+
+  // The command to be sent next, nullptr if the queue is empty. It stays in its slot until pop(), so
+  // it can be sent straight from there.
+  const UyatCommand *peek() const {
+    const auto selected = this->select_();
+    if (!selected.has_value()) {
+      return nullptr;
+    }
+    return &*this->slots_[this->rings_[*selected].at(0u)];
+  }
+
+  // removes the command peek() returned
+  void pop() {
+    const auto selected = this->select_();
+    if (!selected.has_value()) {
+      return;
+    }
+
+    for (std::size_t i = 0; i < NUM_COMMAND_PRIORITIES; ++i) {
+      if ((i == *selected) || this->rings_[i].empty()) {
+        this->skips_[i] = 0u;
+      } else if (i > *selected) {
+        ++this->skips_[i];
+      }
+    }
+
+    this->release_(this->rings_[*selected].pop_front());
+  }
+
+  bool empty() const { return this->num_free_ == COMMAND_QUEUE_SIZE; }
+  std::size_t size() const { return COMMAND_QUEUE_SIZE - this->num_free_; }
+  std::size_t size(const UyatCommandPriority priority) const {
+    return this->rings_[static_cast<std::size_t>(priority)].size();
+  }
+  static constexpr std::size_t capacity() { return COMMAND_QUEUE_SIZE; }
+
+  // the most commands that were ever waiting at once
+  std::size_t get_high_water_mark() const { return this->high_water_; }
+  // commands lost because the queue was full
+  uint32_t get_num_dropped() const { return this->num_dropped_; }
+
+  void clear() {
+    for (std::size_t i = 0; i < NUM_COMMAND_PRIORITIES; ++i) {
+      while (!this->rings_[i].empty()) {
+        this->release_(this->rings_[i].pop_front());
+      }
+    }
+    this->skips_.fill(0u);
+  }
+
+  // newest command of the class accepted by the predicate, nullptr if there's none
+  template<typename Predicate>
+  UyatCommand *find_last_if(const UyatCommandPriority priority, Predicate &&predicate) {
+    const auto &ring = this->rings_[static_cast<std::size_t>(priority)];
+    for (std::size_t i = ring.size(); i-- > 0u;) {
+      auto &command = *this->slots_[ring.at(i)];
+      if (predicate(command)) {
+        return &command;
+      }
+    }
+    return nullptr;
+  }
+
+ private:
+  // FIFO of slot indices
+  struct IndexRing {
+    bool empty() const { return this->count == 0u; }
+    std::size_t size() const { return this->count; }
+    uint8_t at(const std::size_t idx) const { return this->indices[(this->head + idx) % COMMAND_QUEUE_SIZE]; }
+
+    void push_back(const uint8_t slot) {
+      this->indices[(this->head + this->count) % COMMAND_QUEUE_SIZE] = slot;
+      ++this->count;
+    }
+
+    uint8_t pop_front() {
+      const uint8_t slot = this->indices[this->head];
+      this->head = (this->head + 1u) % COMMAND_QUEUE_SIZE;
+      --this->count;
+      return slot;
+    }
+
+    std::array<uint8_t, COMMAND_QUEUE_SIZE> indices{};
+    std::size_t head{0u};
+    std::size_t count{0u};
+  };
+
+  // class the next command is taken from
+  std::optional<std::size_t> select_() const {
+    std::optional<std::size_t> selected{};
+    for (std::size_t i = 0; i < NUM_COMMAND_PRIORITIES; ++i) {
+      if (this->rings_[i].empty()) {
+        continue;
+      }
+      if (!selected.has_value() || (this->skips_[i] >= MAX_SKIPS)) {
+        selected = i;
+        if (this->skips_[i] >= MAX_SKIPS) {
+          break;
+        }
+      }
+    }
+    return selected;
+  }
+
+  void release_(const uint8_t slot) {
+    this->slots_[slot].reset();
+    this->free_slots_[this->num_free_++] = slot;
+  }
+
+  // false if there's no write to remove
+  bool drop_oldest_write_() {
+    auto &ring = this->rings_[static_cast<std::size_t>(UyatCommandPriority::USER_WRITE)];
+    if (ring.empty()) {
+      return false;
+    }
+    this->release_(ring.pop_front());
+    ++this->num_dropped_;
+    return true;
+  }
+
+  // merges all datapoints of a DATAPOINT_DELIVER into the newest queued one
+  bool coalesce_(const UyatCommand &command, const UyatCommandPriority priority) {
+    const auto &ring = this->rings_[static_cast<std::size_t>(priority)];
+    if ((command.cmd != UyatCommandType::DATAPOINT_DELIVER) || ring.empty()) {
+      return false;
+    }
+
+    auto &target = *this->slots_[ring.at(ring.size() - 1u)];
+    if (target.cmd != UyatCommandType::DATAPOINT_DELIVER) {
+      return false;
+    }
+
+    UyatCommand merged = target;
+    const auto payload = command.payload();
+    std::size_t offset = 0u;
+    while (offset < payload.size()) {
+      const auto record = command.find_datapoint_record(payload[offset]);
+      if (!record.has_value() || (record->data() != (payload.data() + offset)) ||
+          !merged.merge_datapoint_record(*record)) {
+        return false;
+      }
+      offset += record->size();
+    }
+    target = merged;
+    return true;
+  }
+
+  std::array<std::optional<UyatCommand>, COMMAND_QUEUE_SIZE> slots_{};
+  std::array<uint8_t, COMMAND_QUEUE_SIZE> free_slots_{};
+  std::size_t num_free_{0u};
+  std::array<IndexRing, NUM_COMMAND_PRIORITIES> rings_{};
+  std::array<uint8_t, NUM_COMMAND_PRIORITIES> skips_{};
+  UyatQueueOverflowPolicy overflow_policy_{UyatQueueOverflowPolicy::DROP_OLDEST};
+  std::size_t high_water_{0u};
+  uint32_t num_dropped_{0u};
+};
+
+// response the mcu sends to a command, none if it doesn't answer it
+static constexpr std::optional<UyatCommandType> expected_response_to(const UyatCommandType command) {
+  switch (command) {
+  case UyatCommandType::HEARTBEAT:
+  case UyatCommandType::PRODUCT_QUERY:
+  case UyatCommandType::CONF_QUERY:
+    return command;
+  case UyatCommandType::DATAPOINT_DELIVER:
+  case UyatCommandType::DATAPOINT_QUERY:
+    return UyatCommandType::DATAPOINT_REPORT_ASYNC;
+  default:
+    return std::nullopt;
+  }
+}
+
+#ifndef UYAT_MAX_COMMANDS_IN_FLIGHT
+#define UYAT_MAX_COMMANDS_IN_FLIGHT 1
+#endif
+
+static constexpr const std::size_t MAX_COMMANDS_IN_FLIGHT = UYAT_MAX_COMMANDS_IN_FLIGHT;
+static_assert(MAX_COMMANDS_IN_FLIGHT > 0u, "UYAT_MAX_COMMANDS_IN_FLIGHT must be at least 1");
+
+// Commands sent to the mcu and waiting for their response. Responses are matched by their command
+// type, so only one command expecting a given response can be in flight at a time. The exception are
+// datapoint writes, which are confirmed by the reports of their datapoints: more of them can be in
+// flight as long as they don't write the same datapoint.
+class UyatInFlightCommands {
+ public:
+  struct Entry {
+    UyatCommand command{UyatCommandType::HEARTBEAT};
+    UyatCommandType response{UyatCommandType::HEARTBEAT};
+    uint32_t sent_at{0u};
+    uint32_t backoff_ms{0u};  // when not awaiting: how long after sent_at the command is sent again
+    uint8_t attempts{0u};
+    bool resent{false};       // a response to a resent command gives no RTT sample (Karn's algorithm)
+    bool awaiting{false};
+    DatapointIds unconfirmed{};  // writes: datapoints not reported back yet
+  };
+
+  bool empty() const { return this->size_ == 0u; }
+  bool full() const { return this->size_ == MAX_COMMANDS_IN_FLIGHT; }
+  std::size_t size() const { return this->size_; }
+  static constexpr std::size_t capacity() { return MAX_COMMANDS_IN_FLIGHT; }
+
+  Entry *begin() { return this->entries_.data(); }
+  Entry *end() { return this->entries_.data() + this->size_; }
+
+  // false if the table is full
+  bool add(const UyatCommand &command, const UyatCommandType response, const uint32_t now) {
+    if (this->full()) {
+      return false;
+    }
+    // filled in place, the command is copied only once
+    auto &entry = this->entries_[this->size_++];
+    entry.command = command;
+    entry.response = response;
+    entry.sent_at = now;
+    entry.backoff_ms = 0u;
+    entry.attempts = 0u;
+    entry.resent = false;
+    entry.awaiting = true;
+    entry.unconfirmed = (command.cmd == UyatCommandType::DATAPOINT_DELIVER) ? command.datapoint_ids() : DatapointIds{};
+    return true;
+  }
+
+  // the command awaiting this response, writes are not matched by the type
+  Entry *find(const UyatCommandType response) {
+    for (auto &entry : *this) {
+      if ((entry.response == response) && !is_write(entry)) {
+        return &entry;
+      }
+    }
+    return nullptr;
+  }
+
+  // true if the response to the command couldn't be told apart from one already awaited
+  bool conflicts(const UyatCommand &command, const UyatCommandType response) const {
+    const bool write = (command.cmd == UyatCommandType::DATAPOINT_DELIVER);
+    const auto ids = write ? command.datapoint_ids() : DatapointIds{};
+    for (std::size_t i = 0; i < this->size_; ++i) {
+      const auto &entry = this->entries_[i];
+      if (entry.response != response) {
+        continue;
+      }
+      if (!write || !is_write(entry)) {
+        return true;
+      }
+      for (const auto id : ids.span()) {
+        if (entry.unconfirmed.contains(id)) {
+          return true;
+        }
+      }
+    }
+    return false;
+  }
+
+  static bool is_write(const Entry &entry) { return entry.command.cmd == UyatCommandType::DATAPOINT_DELIVER; }
+
+  void remove(Entry *entry) {
+    // the order doesn't matter, the last one takes its place
+    Entry *last = &this->entries_[--this->size_];
+    if (entry != last) {
+      *entry = *last;
+    }
+  }
+
+  void clear() { this->size_ = 0u; }
+
+ private:
+  std::array<Entry, MAX_COMMANDS_IN_FLIGHT> entries_{};
+  std::size_t size_{0u};
+};
+
+}
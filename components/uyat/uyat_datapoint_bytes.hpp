@@ -0,0 +1,205 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "uyat_string.hpp"
+
+#ifndef UYAT_DATAPOINT_INLINE_SIZE
+#define UYAT_DATAPOINT_INLINE_SIZE 16
+#endif
+
+namespace esphome::uyat
+{
+
+static constexpr const std::size_t DATAPOINT_INLINE_SIZE = UYAT_DATAPOINT_INLINE_SIZE;
+static_assert(DATAPOINT_INLINE_SIZE >= sizeof(uint8_t*), "UYAT_DATAPOINT_INLINE_SIZE must fit a pointer");
+
+// Value bytes of a RAW or STRING datapoint. Up to DATAPOINT_INLINE_SIZE bytes are stored in the
+// object itself, only longer values are allocated - from the string pool, or from the heap if the
+// pool is exhausted.
+class DatapointBytes
+{
+public:
+   DatapointBytes() = default;
+
+   DatapointBytes(std::span<const uint8_t> bytes)
+   {
+      assign_(bytes.data(), bytes.size());
+   }
+
+   DatapointBytes(const std::vector<uint8_t>& bytes):
+   DatapointBytes(std::span<const uint8_t>(bytes))
+   {}
+
+   DatapointBytes(std::string_view chars)
+   {
+      assign_(reinterpret_cast<const uint8_t*>(chars.data()), chars.size());
+   }
+
+   DatapointBytes(const char* chars):
+   DatapointBytes(std::string_view(chars))
+   {}
+
+   DatapointBytes(const StaticString& chars):
+   DatapointBytes(std::string_view(chars.data(), chars.size()))
+   {}
+
+   DatapointBytes(const DatapointBytes& other)
+   {
+      assign_(other.data(), other.size());
+   }
+
+   DatapointBytes(DatapointBytes&& other)
+   {
+      take_(other);
+   }
+
+   DatapointBytes& operator=(const DatapointBytes& other)
+   {
+      if (this != &other)
+      {
+         release_();
+         assign_(other.data(), other.size());
+      }
+      return *this;
+   }
+
+   DatapointBytes& operator=(DatapointBytes&& other)
+   {
+      if (this != &other)
+      {
+         release_();
+         take_(other);
+      }
+      return *this;
+   }
+
+   ~DatapointBytes()
+   {
+      release_();
+   }
+
+   inline const uint8_t* data() const
+   {
+      return (storage_ == Storage::INLINE)? inline_ : external_;
+   }
+
+   inline std::size_t size() const
+   {
+      return size_;
+   }
+
+   inline bool empty() const
+   {
+      return size_ == 0u;
+   }
+
+   inline bool is_inline() const
+   {
+      return storage_ == Storage::INLINE;
+   }
+
+   inline uint8_t operator[](const std::size_t idx) const
+   {
+      return data()[idx];
+   }
+
+   inline const uint8_t* begin() const
+   {
+      return data();
+   }
+
+   inline const uint8_t* end() const
+   {
+      return data() + size_;
+   }
+
+   inline std::span<const uint8_t> span() const
+   {
+      return std::span<const uint8_t>(data(), size_);
+   }
+
+   inline std::string_view chars() const
+   {
+      return std::string_view(reinterpret_cast<const char*>(data()), size_);
+   }
+
+   bool operator==(const DatapointBytes& other) const
+   {
+      return std::equal(begin(), end(), other.begin(), other.end());
+   }
+
+private:
+   enum class Storage : uint8_t
+   {
+      INLINE,
+      POOL,
+      HEAP,
+   };
+
+   void assign_(const uint8_t* bytes, const std::size_t size)
+   {
+      uint8_t* target = inline_;
+      if (size > DATAPOINT_INLINE_SIZE)
+      {
+         target = StringMemoryPool::get_sma().allocate(size);
+         storage_ = Storage::POOL;
+         if (target == nullptr)
+         {
+            target = new uint8_t[size];
+            storage_ = Storage::HEAP;
+         }
+         external_ = target;
+      }
+      if (size > 0u)
+      {
+         std::memcpy(target, bytes, size);
+      }
+      size_ = static_cast<uint16_t>(size);
+   }
+
+   void take_(DatapointBytes& other)
+   {
+      storage_ = other.storage_;
+      size_ = other.size_;
+      if (storage_ == Storage::INLINE)
+      {
+         std::memcpy(inline_, other.inline_, size_);
+      }
+      else
+      {
+         external_ = other.external_;
+      }
+      other.storage_ = Storage::INLINE;
+      other.size_ = 0u;
+   }
+
+   void release_()
+   {
+      if (storage_ == Storage::POOL)
+      {
+         StringMemoryPool::get_sma().free(external_);
+      }
+      else if (storage_ == Storage::HEAP)
+      {
+         delete[] external_;
+      }
+      storage_ = Storage::INLINE;
+      size_ = 0u;
+   }
+
+   union
+   {
+      uint8_t inline_[DATAPOINT_INLINE_SIZE];
+      uint8_t* external_;
+   };
+   uint16_t size_{0u};
+   Storage storage_{Storage::INLINE};
+};
+
+}
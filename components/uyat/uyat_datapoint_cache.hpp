@@ -0,0 +1,155 @@
+#pragma once
+
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "uyat_datapoint_types.h"
+
+namespace esphome::uyat
+{
+
+// The last value the MCU reported for every datapoint, used to skip writes of unchanged values
+// and to hand the current value to listeners registered late.
+// Values of up to 4 bytes (all BOOL, ENUM, INTEGER and BITMAP ones) are stored inline. Longer RAW
+// and STRING values are only remembered by their length and a 32-bit hash, which is enough to
+// detect a change, unless the full bytes are explicitly retained for the datapoint.
+class DatapointCache
+{
+public:
+   static constexpr std::size_t MAX_INLINE_SIZE = 4u;
+
+   void set_retain_full(const uint8_t datapoint_id)
+   {
+      retain_full_.set(datapoint_id);
+   }
+
+   void store(const uint8_t datapoint_id, const UyatDatapointType type, std::span<const uint8_t> payload)
+   {
+      if (!present_.test(datapoint_id))
+      {
+         index_[datapoint_id] = static_cast<uint8_t>(entries_.size());
+         entries_.push_back(Entry{});
+         present_.set(datapoint_id);
+      }
+
+      auto& entry = entries_[index_[datapoint_id]];
+      entry.type = type;
+      entry.length = static_cast<uint16_t>(payload.size());
+      entry.value = pack_(payload);
+      if (retain_full_.test(datapoint_id) && (payload.size() > MAX_INLINE_SIZE))
+      {
+         // the index of the retained bytes must not reach NOT_RETAINED, a datapoint beyond that is
+         // only kept as its hash
+         if ((entry.retained == NOT_RETAINED) && (retained_.size() < MAX_RETAINED))
+         {
+            entry.retained = static_cast<uint8_t>(retained_.size());
+            retained_.emplace_back();
+         }
+         if (entry.retained != NOT_RETAINED)
+         {
+            retained_[entry.retained].assign(payload.begin(), payload.end());
+         }
+      }
+   }
+
+   inline bool contains(const uint8_t datapoint_id) const
+   {
+      return present_.test(datapoint_id);
+   }
+
+   std::optional<UyatDatapointType> get_type(const uint8_t datapoint_id) const
+   {
+      if (!contains(datapoint_id))
+      {
+         return std::nullopt;
+      }
+      return entries_[index_[datapoint_id]].type;
+   }
+
+   // true if the cached value has the same type and bytes (for the hashed ones: same length and hash)
+   bool equals(const uint8_t datapoint_id, const UyatDatapointType type, std::span<const uint8_t> payload) const
+   {
+      if (!contains(datapoint_id))
+      {
+         return false;
+      }
+      const auto& entry = entries_[index_[datapoint_id]];
+      return (entry.type == type) && (entry.length == payload.size()) && (entry.value == pack_(payload));
+   }
+
+   // the full value, if it's known
+   std::optional<std::span<const uint8_t>> get_payload(const uint8_t datapoint_id) const
+   {
+      if (!contains(datapoint_id))
+      {
+         return std::nullopt;
+      }
+      const auto& entry = entries_[index_[datapoint_id]];
+      if (entry.length <= MAX_INLINE_SIZE)
+      {
+         return std::span<const uint8_t>(reinterpret_cast<const uint8_t*>(&entry.value), entry.length);
+      }
+      if (entry.retained != NOT_RETAINED)
+      {
+         return std::span<const uint8_t>(retained_[entry.retained]);
+      }
+      return std::nullopt;
+   }
+
+   inline std::size_t size() const
+   {
+      return entries_.size();
+   }
+
+   inline std::size_t num_retained() const
+   {
+      return retained_.size();
+   }
+
+private:
+   static constexpr uint8_t NOT_RETAINED = 0xFF;
+   static constexpr std::size_t MAX_RETAINED = NOT_RETAINED;
+
+   struct Entry
+   {
+      UyatDatapointType type{UyatDatapointType::RAW};
+      uint8_t retained{NOT_RETAINED};
+      uint16_t length{0u};
+      uint32_t value{0u};  // the bytes themselves up to MAX_INLINE_SIZE, their hash otherwise
+   };
+
+   static uint32_t pack_(std::span<const uint8_t> payload)
+   {
+      uint32_t value = 0u;
+      if (payload.size() <= MAX_INLINE_SIZE)
+      {
+         if (!payload.empty())
+         {
+            std::memcpy(&value, payload.data(), payload.size());
+         }
+         return value;
+      }
+
+      // FNV-1a
+      value = 2166136261u;
+      for (const auto byte : payload)
+      {
+         value ^= byte;
+         value *= 16777619u;
+      }
+      return value;
+   }
+
+   std::bitset<256> present_{};
+   std::bitset<256> retain_full_{};
+   std::array<uint8_t, 256> index_{};
+   std::vector<Entry> entries_;
+   std::vector<std::vector<uint8_t>> retained_;
+};
+
+}
@@ -1,14 +1,17 @@
 #include <cstdint>
-#include <deque>
 #include <optional>
 #include <variant>
+#include <span>
 #include <string>
+#include <string_view>
+#include <type_traits>
 #include <vector>
-#include <functional>
 
 #include "esphome/core/helpers.h"
 #include "uyat_string.hpp"
-#include "uyat_deque.hpp"
+#include "uyat_ring_buffer.hpp"
+#include "uyat_delegate.hpp"
+#include "uyat_datapoint_bytes.hpp"
 
 #pragma once
 
@@ -98,20 +101,41 @@ struct MatchingDatapoint
   {
     return types.empty();
   }
+
+  static constexpr uint8_t get_type_bit(const UyatDatapointType dp_type)
+  {
+    return (static_cast<uint8_t>(dp_type) < 8u)? static_cast<uint8_t>(1u << static_cast<uint8_t>(dp_type)) : 0u;
+  }
+
+  // one bit per allowed type, so matching a type is a single AND
+  uint8_t get_type_mask() const
+  {
+    if (types.empty())
+    {
+      return 0xFF;
+    }
+
+    uint8_t mask = 0u;
+    for (const auto& type : types)
+    {
+      mask |= get_type_bit(type);
+    }
+    return mask;
+  }
 };
 
 struct RawDatapointValue {
   static constexpr UyatDatapointType dp_type = UyatDatapointType::RAW;
-  std::vector<uint8_t> value;
+  DatapointBytes value;
 
   StaticString to_string() const
   {
-    return StringHelpers::format_hex_pretty(value);
+    return StringHelpers::format_hex_pretty(value.data(), value.size());
   }
 
   std::vector<uint8_t> to_payload() const
   {
-    return value;
+    return std::vector<uint8_t>(value.begin(), value.end());
   }
 
   bool operator==(const RawDatapointValue& other) const
@@ -167,22 +191,16 @@ struct UIntDatapointValue {
 
 struct StringDatapointValue {
   static constexpr UyatDatapointType dp_type = UyatDatapointType::STRING;
-  StaticString value;
+  DatapointBytes value;
 
   StaticString to_string() const
   {
-    return value;
+    return StaticString(value.chars().begin(), value.chars().end());
   }
 
   std::vector<uint8_t> to_payload() const
   {
-    std::vector<uint8_t> data;
-    data.reserve(value.size());
-    for (char const &c : value) {
-      data.push_back(c);
-    }
-
-    return data;
+    return std::vector<uint8_t>(value.begin(), value.end());
   }
 
   bool operator==(const StringDatapointValue& other) const
@@ -313,91 +331,219 @@ struct UyatDatapoint {
   {
     return StringHelpers::sprintf("Datapoint %u: %s (value: %s)", number, get_type_name(), value_to_string().c_str());
   }
+};
+
+// Non-owning view of a received datapoint, the payload points directly into the rx buffer.
+// It is only valid for the duration of the listener call, listeners that need to keep
+// the value must make their own copy (e.g. with to_datapoint()).
+// Views created by parse() always have a payload size matching their type.
+struct DatapointView {
+  uint8_t number;
+  UyatDatapointType type;
+  std::span<const uint8_t> payload;
 
-  static std::optional<UyatDatapoint> construct(const StaticDeque::DequeView &raw_data, std::size_t &used_len)
+  UyatDatapointType get_type() const
   {
-    used_len = 0;
-    if (raw_data.size_ < 4u)
+    return type;
+  }
+
+  const char* get_type_name() const
+  {
+    return MatchingDatapoint::get_type_name(type);
+  }
+
+  bool matches(const MatchingDatapoint& matching) const
+  {
+    return (matching.number == number) && (matching.matches(type));
+  }
+
+  // decodes fixed size values in place, nothing is allocated
+  template<typename T>
+  std::optional<T> get() const
+  {
+    static_assert(!std::is_same_v<T, RawDatapointValue> && !std::is_same_v<T, StringDatapointValue>,
+                  "use get_raw() or get_string() for variable length datapoints");
+
+    if (type != T::dp_type)
     {
-      used_len = raw_data.size_;
-      return {};
+      return std::nullopt;
     }
 
-    size_t payload_size = (raw_data.byte_at(2u) << 8) + raw_data.byte_at(3u);
-    if ((0u == payload_size) || (payload_size > (raw_data.size_ - 4u)))
+    if constexpr (std::is_same_v<T, BoolDatapointValue>)
     {
-      used_len = raw_data.size_;
-      return {};
+      return T{payload[0] != 0x00};
     }
-
-    used_len = payload_size + 4u;
-    const uint8_t dp_type = raw_data.byte_at(1u);
-    const uint8_t dp_number = raw_data.byte_at(0u);
-    const auto payload = raw_data.create_view(4u, payload_size);
-
-    if (dp_type == static_cast<uint8_t>(UyatDatapointType::RAW))
+    else if constexpr (std::is_same_v<T, UIntDatapointValue>)
     {
-      return UyatDatapoint{dp_number, RawDatapointValue{std::vector<uint8_t>(payload.cbegin(), payload.cend())}};
+      return T{encode_uint32(payload[0], payload[1], payload[2], payload[3])};
     }
-    if (dp_type == static_cast<uint8_t>(UyatDatapointType::BOOLEAN))
+    else if constexpr (std::is_same_v<T, EnumDatapointValue>)
     {
-      if (payload.size_ != 1u)
-      {
-        return {};
-      }
-      return UyatDatapoint{dp_number, BoolDatapointValue{payload.byte_at(0) != 0x00}};
+      return T{payload[0]};
     }
-    if (dp_type == static_cast<uint8_t>(UyatDatapointType::INTEGER))
+    else if constexpr (std::is_same_v<T, BitmapDatapointValue>)
     {
-      if (payload.size_ != 4u)
+      if (payload.size() == 1u)
       {
-        return {};
+        return T{payload[0]};
       }
-      return UyatDatapoint{dp_number,
-                           UIntDatapointValue{encode_uint32(payload.byte_at(0), payload.byte_at(1u),
-                                                           payload.byte_at(2u), payload.byte_at(3u))}};
+      if (payload.size() == 2u)
+      {
+        return T{encode_uint16(payload[0], payload[1])};
+      }
+      return T{encode_uint32(payload[0], payload[1], payload[2], payload[3])};
     }
-    if (dp_type == static_cast<uint8_t>(UyatDatapointType::STRING))
+  }
+
+  std::optional<std::span<const uint8_t>> get_raw() const
+  {
+    if (type != UyatDatapointType::RAW)
     {
-      StaticString payload_str;
-      payload_str.reserve(payload.size_);
-      for (size_t i = 0; i < payload.size_; ++i) {
-        payload_str.push_back(static_cast<char>(payload.byte_at(i)));
-      }
-      return UyatDatapoint{dp_number, StringDatapointValue{std::move(payload_str)}};
+      return std::nullopt;
     }
-    if (dp_type == static_cast<uint8_t>(UyatDatapointType::ENUM))
+    return payload;
+  }
+
+  std::optional<std::string_view> get_string() const
+  {
+    if (type != UyatDatapointType::STRING)
     {
-      if (payload.size_ != 1u)
-      {
-        return {};
-      }
-      return UyatDatapoint{dp_number, EnumDatapointValue{payload.byte_at(0)}};
+      return std::nullopt;
     }
-    if (dp_type == static_cast<uint8_t>(UyatDatapointType::BITMAP))
+    return std::string_view(reinterpret_cast<const char*>(payload.data()), payload.size());
+  }
+
+  StaticString value_to_string() const
+  {
+    switch (type)
     {
-      if (payload.size_ == 1u)
-      {
-        return UyatDatapoint{dp_number, BitmapDatapointValue{payload.byte_at(0)}};
-      }
-      if (payload.size_ == 2u)
-      {
-        return UyatDatapoint{dp_number,
-                             BitmapDatapointValue{encode_uint16(payload.byte_at(0), payload.byte_at(1u))}};
-      }
-      if (payload.size_ == 4u)
-      {
-        return UyatDatapoint{dp_number,
-                             BitmapDatapointValue{encode_uint32(payload.byte_at(0), payload.byte_at(1u),
-                                                               payload.byte_at(2u), payload.byte_at(3u))}};
-      }
+      case UyatDatapointType::RAW:
+        return StringHelpers::format_hex_pretty(payload.data(), payload.size());
+      case UyatDatapointType::BOOLEAN:
+        return get<BoolDatapointValue>()->to_string();
+      case UyatDatapointType::INTEGER:
+        return get<UIntDatapointValue>()->to_string();
+      case UyatDatapointType::STRING:
+        return StaticString(payload.begin(), payload.end());
+      case UyatDatapointType::ENUM:
+        return get<EnumDatapointValue>()->to_string();
+      case UyatDatapointType::BITMAP:
+        return get<BitmapDatapointValue>()->to_string();
+      default:
+        return "";
     }
+  }
 
-    return {};
+  StaticString to_string() const
+  {
+    return StringHelpers::sprintf("Datapoint %u: %s (value: %s)", number, get_type_name(), value_to_string().c_str());
+  }
+
+  // makes an owning copy
+  UyatDatapoint to_datapoint() const
+  {
+    switch (type)
+    {
+      case UyatDatapointType::RAW:
+        return UyatDatapoint{number, RawDatapointValue{DatapointBytes(payload)}};
+      case UyatDatapointType::BOOLEAN:
+        return UyatDatapoint{number, *get<BoolDatapointValue>()};
+      case UyatDatapointType::INTEGER:
+        return UyatDatapoint{number, *get<UIntDatapointValue>()};
+      case UyatDatapointType::STRING:
+        return UyatDatapoint{number, StringDatapointValue{DatapointBytes(payload)}};
+      case UyatDatapointType::ENUM:
+        return UyatDatapoint{number, *get<EnumDatapointValue>()};
+      case UyatDatapointType::BITMAP:
+      default:
+        return UyatDatapoint{number, *get<BitmapDatapointValue>()};
+    }
+  }
+
+  static std::optional<DatapointView> parse(const ByteView &raw_data, std::size_t &used_len)
+  {
+    used_len = 0;
+    if (raw_data.size() < 4u)
+    {
+      used_len = raw_data.size();
+      return {};
+    }
+
+    size_t payload_size = (raw_data.byte_at(2u) << 8) + raw_data.byte_at(3u);
+    if ((0u == payload_size) || (payload_size > (raw_data.size() - 4u)))
+    {
+      used_len = raw_data.size();
+      return {};
+    }
+
+    used_len = payload_size + 4u;
+    const uint8_t dp_type = raw_data.byte_at(1u);
+    const uint8_t dp_number = raw_data.byte_at(0u);
+    const auto payload = raw_data.create_view(4u, payload_size).span();
+
+    switch (static_cast<UyatDatapointType>(dp_type))
+    {
+      case UyatDatapointType::RAW:
+      case UyatDatapointType::STRING:
+        break;
+      case UyatDatapointType::BOOLEAN:
+      case UyatDatapointType::ENUM:
+        if (payload.size() != 1u)
+        {
+          return {};
+        }
+        break;
+      case UyatDatapointType::INTEGER:
+        if (payload.size() != 4u)
+        {
+          return {};
+        }
+        break;
+      case UyatDatapointType::BITMAP:
+        if ((payload.size() != 1u) && (payload.size() != 2u) && (payload.size() != 4u))
+        {
+          return {};
+        }
+        break;
+      default:
+        return {};
+    }
+
+    return DatapointView{dp_number, static_cast<UyatDatapointType>(dp_type), payload};
+  }
+};
+
+using OnDatapointCallback = Delegate<void(const DatapointView&)>;
+
+enum class UyatWriteResult: uint8_t {
+  PENDING,
+  CONFIRMED,  // the mcu reported the written value
+  MISMATCH,   // the mcu reported another value
+  TIMEOUT,    // the mcu didn't report the datapoint in time
+  UNTRACKED,  // sent, but too many writes were being tracked to wait for its report
+  NOT_SENT,   // the value doesn't fit in a frame
+  UNKNOWN,    // the handle is too old, its result was forgotten
+};
+
+// Identifies a write made with write_datapoint_value(). It's just a number, it can be copied freely
+// and outlive the write.
+struct WriteHandle
+{
+  uint16_t id{0u};
+
+  bool is_valid() const
+  {
+    return id != 0u;
+  }
+
+  bool operator==(const WriteHandle& other) const
+  {
+    return id == other.id;
   }
 };
 
-using OnDatapointCallback = std::function<void(UyatDatapoint)>;
+// result of a tracked write and how long after sending it was confirmed (or given up on)
+using OnWriteCompleteCallback = Delegate<void(const WriteHandle, const UyatWriteResult, const uint32_t latency_ms)>;
 
 struct DatapointHandler
 {
@@ -405,6 +551,38 @@ struct DatapointHandler
 
   virtual void register_datapoint_listener(const MatchingDatapoint& matching_dp, const OnDatapointCallback& callback) = 0;
   virtual void set_datapoint_value(const UyatDatapoint& dp, const bool forced = false) = 0;
+
+  // Like set_datapoint_value(), but the write is tracked until the mcu reports the datapoint back.
+  // on_complete is called exactly once with the outcome, never before this returns. timeout_ms of 0
+  // uses the configured timeout.
+  virtual WriteHandle write_datapoint_value(const UyatDatapoint& dp, const OnWriteCompleteCallback& on_complete,
+                                            const uint32_t timeout_ms = 0u, const bool forced = false) = 0;
+  virtual UyatWriteResult get_write_result(const WriteHandle handle) const = 0;
+
+  // values set between begin_batch() and the matching commit_batch() are sent together, batches can be nested
+  virtual void begin_batch() = 0;
+  virtual void commit_batch() = 0;
+};
+
+// Sends all datapoint values set during its lifetime as one batch.
+struct DatapointBatch
+{
+  explicit DatapointBatch(DatapointHandler& handler):
+  handler_(handler)
+  {
+    handler_.begin_batch();
+  }
+
+  ~DatapointBatch()
+  {
+    handler_.commit_batch();
+  }
+
+  DatapointBatch(const DatapointBatch&) = delete;
+  DatapointBatch& operator=(const DatapointBatch&) = delete;
+
+private:
+  DatapointHandler& handler_;
 };
 
 }
\ No newline at end of file
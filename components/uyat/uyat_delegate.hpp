@@ -0,0 +1,66 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace esphome::uyat
+{
+
+template<typename Signature, std::size_t StorageSize = 2u * sizeof(void*)>
+class Delegate;
+
+// Non-allocating replacement of std::function for callbacks which live as long as the component.
+// The callable is stored inline, so it must be small and trivially copyable - in practice a lambda
+// capturing `this` or a few pointers/numbers. Anything bigger fails to compile instead of silently
+// going to the heap. Calling an empty delegate does nothing.
+template<typename R, typename... Args, std::size_t StorageSize>
+class Delegate<R(Args...), StorageSize>
+{
+public:
+   Delegate() = default;
+
+   template<typename F,
+            typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, Delegate> && std::is_invocable_r_v<R, std::decay_t<F>&, Args...>>>
+   Delegate(F&& func)
+   {
+      using Callable = std::decay_t<F>;
+      static_assert(sizeof(Callable) <= StorageSize, "Callable too big for the delegate, capture less");
+      static_assert(alignof(Callable) <= alignof(Storage), "Callable alignment not supported by the delegate");
+      static_assert(std::is_trivially_copyable_v<Callable> && std::is_trivially_destructible_v<Callable>,
+                    "Delegate can only store trivially copyable callables");
+
+      ::new (static_cast<void*>(storage_.bytes.data())) Callable(std::forward<F>(func));
+      invoke_ = [](Storage& storage, Args... args) -> R
+      {
+         return (*std::launder(reinterpret_cast<Callable*>(storage.bytes.data())))(std::forward<Args>(args)...);
+      };
+   }
+
+   R operator()(Args... args) const
+   {
+      if (invoke_ == nullptr)
+      {
+         return R();
+      }
+      return invoke_(storage_, std::forward<Args>(args)...);
+   }
+
+   explicit operator bool() const
+   {
+      return invoke_ != nullptr;
+   }
+
+private:
+   struct Storage
+   {
+      alignas(void*) std::array<std::byte, StorageSize> bytes{};
+   };
+
+   mutable Storage storage_{};
+   R (*invoke_)(Storage&, Args...){nullptr};
+};
+
+}
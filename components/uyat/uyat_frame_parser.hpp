@@ -0,0 +1,172 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+
+namespace esphome::uyat
+{
+
+// Incremental parser for the 55 AA framed protocol.
+// It works directly on the rx buffer and remembers how far it got, so bytes that are already
+// parsed are not looked at again when the rest of the frame arrives. The checksum is summed up
+// as the bytes come in. The candidate frame always starts at the beginning of the buffer, whatever
+// turns out to be garbage is removed from the buffer right away, up to the next possible 0x55.
+struct FrameParser
+{
+   static constexpr std::size_t HEADER_SIZE = 6u;  // 55 AA + version + command + 2 bytes of length
+   static constexpr std::size_t CHECKSUM_SIZE = 1u;
+   static constexpr uint8_t HEADER_BYTE_1 = 0x55;
+   static constexpr uint8_t HEADER_BYTE_2 = 0xAA;
+
+   struct Frame
+   {
+      uint8_t version;
+      uint8_t command;
+      uint16_t length;
+
+      std::size_t total_size() const
+      {
+         return HEADER_SIZE + length + CHECKSUM_SIZE;
+      }
+   };
+
+   struct Stats
+   {
+      std::size_t dropped_bytes{0u};
+      std::size_t checksum_errors{0u};
+   };
+
+   // Returns the frame as soon as it is complete and valid. It is then located at the beginning of the buffer
+   // and the caller must consume() exactly Frame::total_size() bytes before calling parse() again.
+   template<typename Buffer>
+   std::optional<Frame> parse(Buffer& buffer, Stats& stats)
+   {
+      while (!buffer.empty())
+      {
+         if (position_ == 0u)
+         {
+            if (buffer.byte_at(0u) != HEADER_BYTE_1)
+            {
+               skip_to_next_candidate_(buffer, 0u, stats);
+               continue;
+            }
+            checksum_ = HEADER_BYTE_1;
+            position_ = 1u;
+         }
+
+         if (position_ < HEADER_SIZE)
+         {
+            const auto header_end = std::min(buffer.size(), HEADER_SIZE);
+            bool broken = false;
+            for (; position_ < header_end; ++position_)
+            {
+               const auto value = buffer.byte_at(position_);
+               if ((position_ == 1u) && (value != HEADER_BYTE_2))
+               {
+                  broken = true;
+                  break;
+               }
+               checksum_ += value;
+            }
+
+            if (broken)
+            {
+               skip_to_next_candidate_(buffer, 1u, stats);
+               continue;
+            }
+
+            if (position_ < HEADER_SIZE)
+            {
+               return std::nullopt;
+            }
+
+            length_ = (uint16_t(buffer.byte_at(4u)) << 8) | uint16_t(buffer.byte_at(5u));
+            if ((HEADER_SIZE + length_ + CHECKSUM_SIZE) > Buffer::capacity())
+            {
+               // could never be received in full, so it is not a frame
+               skip_to_next_candidate_(buffer, 1u, stats);
+               continue;
+            }
+         }
+
+         const std::size_t checksum_offset = HEADER_SIZE + length_;
+         if (position_ < checksum_offset)
+         {
+            const auto available_end = std::min(buffer.size(), checksum_offset);
+            checksum_ += buffer.sum(position_, available_end - position_);
+            position_ = available_end;
+         }
+
+         if (buffer.size() <= checksum_offset)
+         {
+            return std::nullopt;
+         }
+
+         if (buffer.byte_at(checksum_offset) != checksum_)
+         {
+            ++stats.checksum_errors;
+            skip_to_next_candidate_(buffer, 1u, stats);
+            continue;
+         }
+
+         const Frame frame{buffer.byte_at(2u), buffer.byte_at(3u), length_};
+         reset();
+         return frame;
+      }
+
+      return std::nullopt;
+   }
+
+   void reset()
+   {
+      position_ = 0u;
+      length_ = 0u;
+      checksum_ = 0u;
+   }
+
+   // true if some bytes of a not yet complete frame were already parsed
+   bool in_progress() const
+   {
+      return position_ > 0u;
+   }
+
+   // how many more bytes the frame in progress needs, the length counts as 0 until the header is complete
+   std::size_t missing_bytes() const
+   {
+      if (!in_progress())
+      {
+         return 0u;
+      }
+      const std::size_t declared_length = (position_ < HEADER_SIZE)? 0u : length_;
+      return HEADER_SIZE + declared_length + CHECKSUM_SIZE - position_;
+   }
+
+   // gives up on the frame in progress: its first byte is dropped and the bytes after it are parsed
+   // again from the next possible frame start, so a valid frame that came after it is not lost
+   template<typename Buffer>
+   void abandon_frame(Buffer& buffer, Stats& stats)
+   {
+      if (in_progress())
+      {
+         skip_to_next_candidate_(buffer, 1u, stats);
+      }
+   }
+
+private:
+
+   template<typename Buffer>
+   void skip_to_next_candidate_(Buffer& buffer, const std::size_t search_from, Stats& stats)
+   {
+      const auto next_candidate = buffer.find(HEADER_BYTE_1, search_from);
+      stats.dropped_bytes += next_candidate;
+      buffer.consume(next_candidate);
+      reset();
+   }
+
+   std::size_t position_{0u};
+   uint16_t length_{0u};
+   uint8_t checksum_{0u};
+};
+
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace esphome::uyat
+{
+
+// Listeners indexed by datapoint id. All of them are kept in a single vector ordered by id,
+// offsets_[id] .. offsets_[id + 1] is the range belonging to the datapoint (as in a CSR matrix).
+// Looking up the listeners of a datapoint is O(1), adding one is O(n), but that only happens
+// during setup.
+template<typename Listener>
+class DatapointListenerTable
+{
+public:
+   static constexpr std::size_t NUM_DATAPOINT_IDS = 256u;
+
+   void add(const uint8_t datapoint_id, const Listener& listener)
+   {
+      const auto insert_at = offsets_[datapoint_id + 1u];
+      listeners_.insert(listeners_.begin() + insert_at, listener);
+      for (std::size_t id = datapoint_id + 1u; id < offsets_.size(); ++id)
+      {
+         ++offsets_[id];
+      }
+   }
+
+   std::span<Listener> for_datapoint(const uint8_t datapoint_id)
+   {
+      return std::span<Listener>(listeners_).subspan(offsets_[datapoint_id], offsets_[datapoint_id + 1u] - offsets_[datapoint_id]);
+   }
+
+   inline bool has_listeners(const uint8_t datapoint_id) const
+   {
+      return offsets_[datapoint_id + 1u] != offsets_[datapoint_id];
+   }
+
+   // all the listeners, ordered by datapoint id
+   std::span<const Listener> all() const
+   {
+      return listeners_;
+   }
+
+   inline std::size_t size() const
+   {
+      return listeners_.size();
+   }
+
+private:
+   std::vector<Listener> listeners_;
+   std::array<uint16_t, NUM_DATAPOINT_IDS + 1u> offsets_{};
+};
+
+}
@@ -0,0 +1,207 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <span>
+
+namespace esphome::uyat
+{
+
+#ifndef UYAT_RX_BUFFER_SIZE
+#define UYAT_RX_BUFFER_SIZE 2048
+#endif
+
+// the longest frame the mcu can send
+static constexpr const std::size_t MAX_RX_BUFFER_SIZE = UYAT_RX_BUFFER_SIZE;
+
+// non-owning, always contiguous view of (a part of) the received bytes
+struct ByteView
+{
+   inline const uint8_t* cbegin() const
+   {
+      return data_.data();
+   }
+
+   inline const uint8_t* cend() const
+   {
+      return data_.data() + data_.size();
+   }
+
+   inline std::size_t size() const
+   {
+      return data_.size();
+   }
+
+   inline bool empty() const
+   {
+      return data_.empty();
+   }
+
+   inline uint8_t byte_at(const std::size_t idx) const
+   {
+      return data_[idx];
+   }
+
+   inline std::span<const uint8_t> span() const
+   {
+      return data_;
+   }
+
+   ByteView create_view(const std::size_t offset, const std::size_t size) const
+   {
+      if ((offset >= data_.size()) || ((offset + size) > data_.size()))
+      {
+         return ByteView{};
+      }
+      return ByteView{data_.subspan(offset, size)};
+   }
+
+   std::span<const uint8_t> data_{};
+};
+
+// Fixed capacity byte FIFO. Appending and consuming are O(1) (apart from the copy itself),
+// the storage is only rearranged when a contiguous view is requested over the wrap point.
+template<std::size_t Capacity>
+struct StaticRingBuffer
+{
+   static_assert(Capacity > 0u, "Capacity must not be 0");
+
+   inline std::size_t size() const
+   {
+      return size_;
+   }
+
+   inline std::size_t free_space() const
+   {
+      return Capacity - size_;
+   }
+
+   inline bool empty() const
+   {
+      return size_ == 0u;
+   }
+
+   static constexpr std::size_t capacity()
+   {
+      return Capacity;
+   }
+
+   inline uint8_t byte_at(const std::size_t idx) const
+   {
+      return buffer_[wrap_(head_ + idx)];
+   }
+
+   // offset of the first byte equal to value at or after from, size() if there is none
+   std::size_t find(const uint8_t value, const std::size_t from) const
+   {
+      if (from >= size_)
+      {
+         return size_;
+      }
+
+      const auto start = wrap_(head_ + from);
+      const auto first_len = std::min(size_ - from, Capacity - start);
+      if (auto* found = static_cast<const uint8_t*>(std::memchr(&buffer_[start], value, first_len)))
+      {
+         return from + (found - &buffer_[start]);
+      }
+
+      const auto second_len = (size_ - from) - first_len;
+      if (auto* found = static_cast<const uint8_t*>(std::memchr(&buffer_[0], value, second_len)))
+      {
+         return from + first_len + (found - &buffer_[0]);
+      }
+
+      return size_;
+   }
+
+   // sum (modulo 256) of len bytes starting at offset
+   uint8_t sum(const std::size_t offset, std::size_t len) const
+   {
+      if (offset >= size_)
+      {
+         return 0u;
+      }
+
+      len = std::min(len, size_ - offset);
+      uint8_t result = 0u;
+      std::size_t idx = wrap_(head_ + offset);
+      while (len > 0u)
+      {
+         const auto chunk = std::min(len, Capacity - idx);
+         for (const auto end = idx + chunk; idx < end; ++idx)
+         {
+            result += buffer_[idx];
+         }
+         len -= chunk;
+         idx = 0u;
+      }
+      return result;
+   }
+
+   // contiguous free space right after the last byte, it can be filled in place and then commit()-ed
+   std::span<uint8_t> write_span()
+   {
+      if (size_ == Capacity)
+      {
+         return {};
+      }
+      const auto tail = wrap_(head_ + size_);
+      const auto end = (tail >= head_)? Capacity : head_;
+      return std::span<uint8_t>(&buffer_[tail], end - tail);
+   }
+
+   // makes n bytes written via write_span() part of the buffer
+   void commit(const std::size_t n)
+   {
+      size_ += std::min(n, free_space());
+   }
+
+   // removes n bytes from the front
+   void consume(std::size_t n)
+   {
+      n = std::min(n, size_);
+      size_ -= n;
+      // restart from the beginning when possible, this keeps most frames contiguous
+      head_ = (size_ == 0u)? 0u : wrap_(head_ + n);
+   }
+
+   // returns a contiguous view, the storage is rotated first if the requested range wraps
+   ByteView linear_view(const std::size_t offset, const std::size_t size)
+   {
+      if ((offset >= size_) || ((offset + size) > size_))
+      {
+         return ByteView{};
+      }
+
+      const auto start = head_ + offset;
+      if ((start < Capacity) && ((start + size) > Capacity))
+      {
+         linearize_();
+      }
+      return ByteView{std::span<const uint8_t>(&buffer_[wrap_(head_ + offset)], size)};
+   }
+
+private:
+
+   static inline std::size_t wrap_(const std::size_t idx)
+   {
+      return (idx >= Capacity)? (idx - Capacity) : idx;
+   }
+
+   void linearize_()
+   {
+      std::rotate(buffer_.begin(), buffer_.begin() + head_, buffer_.end());
+      head_ = 0u;
+   }
+
+   std::array<uint8_t, Capacity> buffer_{};
+   std::size_t head_{0u};
+   std::size_t size_{0u};
+};
+
+using RxRingBuffer = StaticRingBuffer<MAX_RX_BUFFER_SIZE>;
+
+}
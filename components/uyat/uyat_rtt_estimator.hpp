@@ -0,0 +1,83 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace esphome::uyat
+{
+
+// Request->response round-trip time estimate, computed the way RFC 6298 does it for TCP:
+// smoothed RTT and its mean deviation, the timeout is SRTT + 4 * RTTVAR. All times in ms.
+struct RttEstimator
+{
+   void add_sample(const uint32_t rtt_ms)
+   {
+      const float sample = static_cast<float>(rtt_ms);
+      if (num_samples_ == 0u)
+      {
+         srtt_ = sample;
+         rttvar_ = sample / 2.0f;
+      }
+      else
+      {
+         rttvar_ = (1.0f - BETA) * rttvar_ + BETA * std::fabs(srtt_ - sample);
+         srtt_ = (1.0f - ALPHA) * srtt_ + ALPHA * sample;
+      }
+
+      if (num_samples_ < UINT32_MAX)
+      {
+         ++num_samples_;
+      }
+   }
+
+   inline bool has_samples() const
+   {
+      return num_samples_ > 0u;
+   }
+
+   inline uint32_t get_num_samples() const
+   {
+      return num_samples_;
+   }
+
+   inline float get_srtt() const
+   {
+      return srtt_;
+   }
+
+   inline float get_rttvar() const
+   {
+      return rttvar_;
+   }
+
+   // timeout derived from the estimate and clamped to [min_ms, max_ms], max_ms until anything was measured
+   uint32_t get_timeout(const uint32_t min_ms, const uint32_t max_ms) const
+   {
+      if (!has_samples())
+      {
+         return max_ms;
+      }
+
+      // at least one millis() tick of variation, as G in RFC 6298
+      const auto timeout = static_cast<uint32_t>(std::ceil(srtt_ + std::max(1.0f, 4.0f * rttvar_)));
+      return std::clamp(timeout, min_ms, std::max(min_ms, max_ms));
+   }
+
+   void reset()
+   {
+      srtt_ = 0.0f;
+      rttvar_ = 0.0f;
+      num_samples_ = 0u;
+   }
+
+private:
+   static constexpr float ALPHA = 1.0f / 8.0f;
+   static constexpr float BETA = 1.0f / 4.0f;
+
+   float srtt_{0.0f};
+   float rttvar_{0.0f};
+   uint32_t num_samples_{0u};
+};
+
+}
@@ -1,5 +1,6 @@
 #pragma once
 #include "esphome/core/helpers.h"
+#include <array>
 #include <vector>
 #include "sma_stl.hpp"
 #include <cstring>
@@ -8,28 +9,51 @@
 namespace esphome::uyat
 {
 
-static constexpr const std::size_t MAX_STRING_BUFFER_SIZE = 1024u * 2u;
-static constexpr const std::size_t MAX_STRING_BUFFER_SLOTS = 20u;
+#ifndef UYAT_STRING_POOL_SIZE
+#define UYAT_STRING_POOL_SIZE 2048
+#endif
 
-struct StringMemoryPool
-{
-   StringMemoryPool(const std::size_t max_buffer_size, const std::size_t max_buffer_chunks):
-   buffer_(max_buffer_size),
-   allocator_(buffer_, max_buffer_chunks)
-   {}
+#ifndef UYAT_STRING_POOL_SLOTS
+#define UYAT_STRING_POOL_SLOTS 128
+#endif
+
+static constexpr const std::size_t MAX_STRING_BUFFER_SIZE = UYAT_STRING_POOL_SIZE;
+// allocations don't get slower with more of them, the buffer size is the real limit
+static constexpr const std::size_t MAX_STRING_BUFFER_SLOTS = UYAT_STRING_POOL_SLOTS;
 
+// Size bytes of memory in .bss, handed out by a StaticMemoryAllocator. Each instantiation is a
+// separate pool, created at its first use. Allocations which don't fit fall back to the heap.
+template<std::size_t Size, std::size_t Slots>
+class StaticMemoryPool
+{
+public:
    static sma::StaticMemoryAllocator& get_sma()
    {
-      static StringMemoryPool instance(MAX_STRING_BUFFER_SIZE, MAX_STRING_BUFFER_SLOTS);
+      static StaticMemoryPool instance;
       return instance.allocator_;
    }
 
+   static constexpr std::size_t capacity()
+   {
+      return Size;
+   }
+
+   static constexpr std::size_t max_slots()
+   {
+      return Slots;
+   }
+
 private:
+   StaticMemoryPool():
+   allocator_(buffer_, Slots)
+   {}
 
-   std::vector<uint8_t> buffer_;
+   alignas(4) std::array<uint8_t, Size> buffer_;
    sma::StaticMemoryAllocator allocator_;
 };
 
+using StringMemoryPool = StaticMemoryPool<MAX_STRING_BUFFER_SIZE, MAX_STRING_BUFFER_SLOTS>;
+
 using StaticString = std::basic_string<char, std::char_traits<char>, sma::STLAllocator<char, StringMemoryPool>>;
 
 struct StringHelpers
@@ -0,0 +1,81 @@
+#include "uyat_warm_start.h"
+
+#include <cstddef>
+
+#include "esphome/core/helpers.h"
+
+namespace esphome::uyat {
+
+bool WarmStartSnapshot::can_store(const UyatDatapointType type, const std::size_t length) {
+  switch (type) {
+  case UyatDatapointType::BOOLEAN:
+  case UyatDatapointType::ENUM:
+    return length == 1u;
+  case UyatDatapointType::INTEGER:
+    return length == 4u;
+  case UyatDatapointType::BITMAP:
+    return (length == 1u) || (length == 2u) || (length == 4u);
+  default:
+    return false;
+  }
+}
+
+void WarmStartSnapshot::seal() {
+  this->version = WARM_START_VERSION;
+  this->crc = this->compute_crc_();
+}
+
+bool WarmStartSnapshot::is_valid() const {
+  if ((this->version != WARM_START_VERSION) || (this->num_datapoints > MAX_WARM_START_DATAPOINTS) ||
+      (this->crc != this->compute_crc_())) {
+    return false;
+  }
+  for (uint8_t i = 0; i < this->num_datapoints; i++) {
+    if (!can_store(this->datapoints[i].type, this->datapoints[i].length)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+uint16_t WarmStartSnapshot::compute_crc_() const {
+  return crc16(reinterpret_cast<const uint8_t *>(this), offsetof(WarmStartSnapshot, crc));
+}
+
+PreferencesWarmStartBackend::PreferencesWarmStartBackend(const WarmStartStorage storage) {
+  const bool in_flash = (storage == WarmStartStorage::FLASH);
+  this->slots_[0] = global_preferences->make_preference<WarmStartSnapshot>(fnv1_hash("uyat_warm_start_0"), in_flash);
+  this->slots_[1] = global_preferences->make_preference<WarmStartSnapshot>(fnv1_hash("uyat_warm_start_1"), in_flash);
+}
+
+bool PreferencesWarmStartBackend::load(WarmStartSnapshot &snapshot) {
+  WarmStartSnapshot candidates[2];
+  bool valid[2];
+  for (uint8_t i = 0; i < 2; i++) {
+    // a slot whose write got interrupted fails the check, the other one is used then
+    valid[i] = this->slots_[i].load(&candidates[i]) && candidates[i].is_valid();
+  }
+
+  if (!valid[0] && !valid[1]) {
+    return false;
+  }
+
+  uint8_t newest = valid[0] ? 0 : 1;
+  if (valid[0] && valid[1] && (int32_t) (candidates[1].sequence - candidates[0].sequence) > 0) {
+    newest = 1;
+  }
+  snapshot = candidates[newest];
+  // the other slot is overwritten next
+  this->next_slot_ = newest ^ 1u;
+  return true;
+}
+
+bool PreferencesWarmStartBackend::save(const WarmStartSnapshot &snapshot) {
+  if (!this->slots_[this->next_slot_].save(&snapshot)) {
+    return false;
+  }
+  this->next_slot_ ^= 1u;
+  return true;
+}
+
+}  // namespace esphome::uyat
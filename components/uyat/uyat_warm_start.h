@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "esphome/core/preferences.h"
+
+#include "uyat_datapoint_types.h"
+
+namespace esphome::uyat
+{
+
+static constexpr const std::size_t MAX_WARM_START_DATAPOINTS = 32u;
+// bump when the layout of WarmStartSnapshot changes
+static constexpr const uint8_t WARM_START_VERSION = 2u;
+
+// Last known values of the datapoints, kept across reboots. Only the fixed size types (all but RAW
+// and STRING) are stored - longer values are not fully cached anyway.
+struct WarmStartSnapshot {
+  struct Datapoint {
+    uint8_t number;
+    UyatDatapointType type;
+    uint8_t length;
+    uint8_t value[4];
+  };
+
+  uint32_t sequence;  // of the save, the newest snapshot wins
+  uint8_t version;
+  uint8_t num_datapoints;
+  Datapoint datapoints[MAX_WARM_START_DATAPOINTS];
+  uint16_t crc;  // of everything above
+
+  // true if a value of the type and length can be stored
+  static bool can_store(const UyatDatapointType type, const std::size_t length);
+
+  // sets the version and the crc, call once the datapoints are filled in
+  void seal();
+  // A snapshot which was stored by another version, got damaged or has a datapoint with an unknown
+  // type or a length not matching its type is not valid and must be ignored as a whole.
+  bool is_valid() const;
+
+ protected:
+  uint16_t compute_crc_() const;
+};
+
+static constexpr const std::size_t MAX_CACHED_PRODUCT_SIZE = 127u;
+
+// Outcome of the last full handshake (PRODUCT_QUERY and CONF_QUERY responses), used to skip both
+// queries when the ESP reboots but the MCU keeps running.
+struct CachedHandshake {
+  uint8_t product_length;
+  char product[MAX_CACHED_PRODUCT_SIZE];
+  int8_t status_pin;
+  int8_t reset_pin;
+};
+
+// Where the snapshot is kept. Implement it to store the snapshot somewhere else than in the preferences.
+class WarmStartBackend {
+ public:
+  virtual ~WarmStartBackend() = default;
+  virtual bool load(WarmStartSnapshot &snapshot) = 0;
+  virtual bool save(const WarmStartSnapshot &snapshot) = 0;
+};
+
+enum class WarmStartStorage : uint8_t {
+  FLASH,
+  RTC,  // survives a reboot but not a power loss, without any flash wear
+};
+
+// Stores the snapshot in ESPHome preferences. Two slots are written in turns, the valid one with the
+// higher sequence number wins when loading - this halves the wear of each of them and keeps the
+// previous snapshot if a write gets interrupted.
+class PreferencesWarmStartBackend : public WarmStartBackend {
+ public:
+  explicit PreferencesWarmStartBackend(const WarmStartStorage storage);
+  bool load(WarmStartSnapshot &snapshot) override;
+  bool save(const WarmStartSnapshot &snapshot) override;
+
+ protected:
+  ESPPreferenceObject slots_[2];
+  uint8_t next_slot_{0};
+};
+
+}  // namespace esphome::uyat
@@ -0,0 +1,264 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <span>
+
+#include "uyat_datapoint_types.h"
+#include "uyat_rtt_estimator.hpp"
+
+#ifndef UYAT_MAX_TRACKED_WRITES
+#define UYAT_MAX_TRACKED_WRITES 8
+#endif
+
+namespace esphome::uyat
+{
+
+static constexpr const std::size_t MAX_TRACKED_WRITES = UYAT_MAX_TRACKED_WRITES;
+static_assert((MAX_TRACKED_WRITES > 0u) && (MAX_TRACKED_WRITES <= 255u), "UYAT_MAX_TRACKED_WRITES must be 1..255");
+
+constexpr const char* write_result_to_string(const UyatWriteResult result)
+{
+   switch (result)
+   {
+      case UyatWriteResult::PENDING:
+         return "pending";
+      case UyatWriteResult::CONFIRMED:
+         return "confirmed";
+      case UyatWriteResult::MISMATCH:
+         return "mismatch";
+      case UyatWriteResult::TIMEOUT:
+         return "timeout";
+      case UyatWriteResult::UNTRACKED:
+         return "sent untracked";
+      case UyatWriteResult::NOT_SENT:
+         return "not sent";
+      default:
+         return "unknown";
+   }
+}
+
+// true if the reported value is the written one. BITMAP values are compared as numbers, the mcu
+// doesn't have to report them with the same width as they were written.
+inline bool same_datapoint_value(const UyatDatapointType type, std::span<const uint8_t> written,
+                                 std::span<const uint8_t> reported)
+{
+   if ((type == UyatDatapointType::BITMAP) && (written.size() <= 4u) && (reported.size() <= 4u))
+   {
+      const auto to_number = [](std::span<const uint8_t> bytes)
+      {
+         uint32_t number = 0u;
+         for (const auto byte : bytes)
+         {
+            number = (number << 8) | byte;
+         }
+         return number;
+      };
+      return to_number(written) == to_number(reported);
+   }
+   return std::equal(written.begin(), written.end(), reported.begin(), reported.end());
+}
+
+// Writes made with write_datapoint_value(), waiting for the mcu to report their datapoint back.
+// A write is confirmed by the first report of its datapoint after the value was sent, if it's the
+// written value, otherwise it fails as a mismatch. Finished writes keep their result until the
+// slot is needed again.
+class WriteTracker
+{
+public:
+   // invalid handle if all slots are taken by pending writes
+   WriteHandle track(const uint8_t datapoint_id, const UyatDatapointType type, std::span<const uint8_t> payload,
+                     const uint32_t timeout_ms, const OnWriteCompleteCallback& on_complete, const uint32_t now)
+   {
+      Record* slot = nullptr;
+      for (auto& record : records_)
+      {
+         if (record.result != UyatWriteResult::PENDING)
+         {
+            // the oldest finished write is forgotten first
+            if ((slot == nullptr) || (record.handle.id == 0u) || ((slot->handle.id != 0u) && older_(record, *slot)))
+            {
+               slot = &record;
+            }
+         }
+      }
+      if (slot == nullptr)
+      {
+         return WriteHandle{};
+      }
+
+      if (++last_id_ == 0u)
+      {
+         last_id_ = 1u;
+      }
+      *slot = Record{
+         .handle = WriteHandle{last_id_},
+         .datapoint_id = datapoint_id,
+         .type = type,
+         .result = UyatWriteResult::PENDING,
+         .sent = false,
+         .started_at = now,
+         .sent_at = now,
+         .timeout_ms = timeout_ms,
+         .value = DatapointBytes(payload),
+         .on_complete = on_complete,
+      };
+      pending_.set(datapoint_id);
+      return slot->handle;
+   }
+
+   UyatWriteResult get_result(const WriteHandle handle) const
+   {
+      for (const auto& record : records_)
+      {
+         if (handle.is_valid() && (record.handle == handle))
+         {
+            return record.result;
+         }
+      }
+      return UyatWriteResult::UNKNOWN;
+   }
+
+   // the frame carrying these datapoints went out, reports from now on are answers to it
+   void on_sent(const std::span<const uint8_t> datapoint_ids, const uint32_t now)
+   {
+      const auto is_pending = [this](const uint8_t id) { return pending_.test(id); };
+      if (std::none_of(datapoint_ids.begin(), datapoint_ids.end(), is_pending))
+      {
+         return;
+      }
+      for (auto& record : records_)
+      {
+         if ((record.result == UyatWriteResult::PENDING) && !record.sent &&
+             (std::find(datapoint_ids.begin(), datapoint_ids.end(), record.datapoint_id) != datapoint_ids.end()))
+         {
+            record.sent = true;
+            record.sent_at = now;
+         }
+      }
+   }
+
+   void on_report(const DatapointView& datapoint, const uint32_t now)
+   {
+      if (!pending_.test(datapoint.number))
+      {
+         return;
+      }
+      // the writes answered by this report are picked first: a callback may start a new write of
+      // the same datapoint, and this report isn't an answer to that one
+      std::array<uint8_t, MAX_TRACKED_WRITES> answered;
+      std::size_t num_answered = 0u;
+      for (std::size_t i = 0u; i < records_.size(); i++)
+      {
+         const auto& record = records_[i];
+         if ((record.result == UyatWriteResult::PENDING) && record.sent && (record.datapoint_id == datapoint.number))
+         {
+            answered[num_answered++] = static_cast<uint8_t>(i);
+         }
+      }
+
+      for (std::size_t i = 0u; i < num_answered; i++)
+      {
+         auto& record = records_[answered[i]];
+         const bool same = (record.type == datapoint.type) &&
+                           same_datapoint_value(record.type, record.value.span(), datapoint.payload);
+         if (same)
+         {
+            latency_.add_sample(now - record.sent_at);
+         }
+         finish_(record, same? UyatWriteResult::CONFIRMED : UyatWriteResult::MISMATCH, now - record.sent_at);
+      }
+   }
+
+   // the write is over without waiting for a report, eg. the value was already there
+   void complete(const WriteHandle handle, const UyatWriteResult result)
+   {
+      for (auto& record : records_)
+      {
+         if (handle.is_valid() && (record.handle == handle) && (record.result == UyatWriteResult::PENDING))
+         {
+            finish_(record, result, 0u);
+         }
+      }
+   }
+
+   void expire(const uint32_t now)
+   {
+      if (pending_.none())
+      {
+         return;
+      }
+      for (auto& record : records_)
+      {
+         if ((record.result == UyatWriteResult::PENDING) && ((now - record.started_at) > record.timeout_ms))
+         {
+            finish_(record, UyatWriteResult::TIMEOUT, now - record.sent_at);
+         }
+      }
+   }
+
+   std::size_t num_pending() const
+   {
+      return std::count_if(records_.begin(), records_.end(),
+                           [](const Record& record) { return record.result == UyatWriteResult::PENDING; });
+   }
+
+   // time from sending a value to its confirmation, over all confirmed writes
+   const RttEstimator& get_latency() const
+   {
+      return latency_;
+   }
+
+   static constexpr std::size_t capacity()
+   {
+      return MAX_TRACKED_WRITES;
+   }
+
+private:
+   struct Record
+   {
+      WriteHandle handle{};
+      uint8_t datapoint_id{0u};
+      UyatDatapointType type{UyatDatapointType::RAW};
+      UyatWriteResult result{UyatWriteResult::UNKNOWN};
+      bool sent{false};
+      uint32_t started_at{0u};
+      uint32_t sent_at{0u};
+      uint32_t timeout_ms{0u};
+      DatapointBytes value{};
+      OnWriteCompleteCallback on_complete{};
+   };
+
+   bool older_(const Record& a, const Record& b) const
+   {
+      // ids wrap around, the distance from the newest one tells the age
+      return static_cast<uint16_t>(last_id_ - a.handle.id) > static_cast<uint16_t>(last_id_ - b.handle.id);
+   }
+
+   void finish_(Record& record, const UyatWriteResult result, const uint32_t latency_ms)
+   {
+      record.result = result;
+      update_pending_(record.datapoint_id);
+      // the callback may start another write, which can reuse this very slot
+      const auto on_complete = record.on_complete;
+      on_complete(record.handle, result, latency_ms);
+   }
+
+   void update_pending_(const uint8_t datapoint_id)
+   {
+      const bool any = std::any_of(records_.begin(), records_.end(), [datapoint_id](const Record& record)
+      {
+         return (record.result == UyatWriteResult::PENDING) && (record.datapoint_id == datapoint_id);
+      });
+      pending_.set(datapoint_id, any);
+   }
+
+   std::array<Record, MAX_TRACKED_WRITES> records_{};
+   std::bitset<256> pending_{};
+   uint16_t last_id_{0u};
+   RttEstimator latency_{};
+};
+
+}